@@ -0,0 +1,152 @@
+/*
+ * arena.c -- per request allocator
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+/* Usable bytes of a regular chunk, larger allocations get their own. */
+#define CHUNK   8192
+
+/* Every allocation is aligned for any type. */
+#define ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+/* Memory of a chunk, right after its header. */
+#define DATA(c) ((unsigned char *)(c) + ALIGN(sizeof (struct arena_chunk)))
+
+struct arena_chunk {
+	struct arena_chunk *prev;
+	size_t size;
+	size_t used;
+};
+
+struct arena arena;
+
+static struct arena_chunk *
+chunk(size_t size)
+{
+	struct arena_chunk *c;
+
+	if (!(c = malloc(ALIGN(sizeof (*c)) + size)))
+		die("abort: %s", strerror(errno));
+
+	c->prev = NULL;
+	c->size = size;
+	c->used = 0;
+
+	return c;
+}
+
+void *
+arena_alloc(struct arena *ar, size_t size)
+{
+	assert(ar);
+
+	struct arena_chunk *c = ar->chunk, *big;
+	void *ptr;
+
+	size = ALIGN(size ? size : 1);
+
+	if (!c || c->size - c->used < size) {
+		/* Behind the current chunk so that its free space stays in use. */
+		if (size > CHUNK / 4 && c) {
+			big = chunk(size);
+			big->prev = c->prev;
+			c->prev = big;
+			ptr = DATA(big);
+			goto done;
+		}
+
+		c = chunk(size > CHUNK ? size : CHUNK);
+		c->prev = ar->chunk;
+		ar->chunk = c;
+	}
+
+	ptr = DATA(c) + c->used;
+	c->used += size;
+
+done:
+	ar->allocs++;
+	ar->bytes += size;
+
+	return memset(ptr, 0, size);
+}
+
+char *
+arena_strdup(struct arena *ar, const char *s)
+{
+	assert(ar);
+	assert(s);
+
+	return arena_strndup(ar, s, strlen(s));
+}
+
+char *
+arena_strndup(struct arena *ar, const char *s, size_t len)
+{
+	assert(ar);
+	assert(s || len == 0);
+
+	char *ret = arena_alloc(ar, len + 1);
+
+	if (len)
+		memcpy(ret, s, len);
+
+	return ret;
+}
+
+void
+arena_reset(struct arena *ar)
+{
+	assert(ar);
+
+	struct arena_chunk *c, *prev, *keep = NULL;
+
+	/* Keep one regular chunk for the next request. */
+	for (c = ar->chunk; c; c = prev) {
+		prev = c->prev;
+
+		if (!keep && c->size == CHUNK)
+			keep = c;
+		else
+			free(c);
+	}
+
+	if (keep) {
+		keep->prev = NULL;
+		keep->used = 0;
+	}
+
+	ar->chunk = keep;
+	ar->allocs = 0;
+	ar->bytes = 0;
+}
+
+void
+arena_finish(struct arena *ar)
+{
+	assert(ar);
+
+	arena_reset(ar);
+	free(ar->chunk);
+	memset(ar, 0, sizeof (*ar));
+}
@@ -0,0 +1,65 @@
+/*
+ * arena.h -- per request allocator
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PASTER_ARENA_H
+#define PASTER_ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Bump allocator whose memory is released all at once, for the strings
+ * that only live during a request. The first chunk is kept by
+ * arena_reset so that a worker serving small requests reuses the same
+ * memory instead of going through malloc.
+ */
+struct arena {
+	struct arena_chunk *chunk;      /* Current chunk, linked to the previous. */
+	size_t allocs;                  /* Allocations since the last reset. */
+	size_t bytes;                   /* Bytes allocated since the last reset. */
+};
+
+/**
+ * Arena of the request being processed, reset once it is answered.
+ */
+extern struct arena arena;
+
+/**
+ * Return zeroed memory valid until the next arena_reset, aborts on
+ * allocation failure like ecalloc.
+ */
+void *
+arena_alloc(struct arena *, size_t);
+
+char *
+arena_strdup(struct arena *, const char *);
+
+/**
+ * Copy len bytes of s, NUL terminated.
+ */
+char *
+arena_strndup(struct arena *, const char *, size_t);
+
+/**
+ * Release everything allocated so far but the first chunk.
+ */
+void
+arena_reset(struct arena *);
+
+void
+arena_finish(struct arena *);
+
+#endif /* !PASTER_ARENA_H */
@@ -0,0 +1,133 @@
+/*
+ * bloom.c -- membership filter of paste identifiers
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom.h"
+#include "util.h"
+
+/* 10 bits and 7 hashes per identifier give about 1% of false positives. */
+#define BITS    10
+#define HASHES  7
+
+/*
+ * Two FNV-1a hashes with different offsets, combined to get the other ones.
+ */
+static void
+hash(const char *id, uint64_t *h1, uint64_t *h2)
+{
+	uint64_t a = 14695981039346656037ULL, b = 2166136261U;
+
+	for (; *id; ++id) {
+		a = (a ^ (unsigned char)*id) * 1099511628211ULL;
+		b = (b ^ (unsigned char)*id) * 16777619U;
+	}
+
+	*h1 = a;
+	*h2 = b | 1;
+}
+
+void
+bloom_init(struct bloom *bloom, size_t capacity)
+{
+	assert(bloom);
+
+	memset(bloom, 0, sizeof (*bloom));
+	bloom->capacity = capacity ? capacity : 1;
+	bloom->bitsz = bloom->capacity * BITS;
+	bloom->bits = ecalloc(1, (bloom->bitsz + 7) / 8);
+}
+
+void
+bloom_add(struct bloom *bloom, const char *id)
+{
+	assert(bloom);
+	assert(id);
+
+	uint64_t h1, h2, bit;
+
+	hash(id, &h1, &h2);
+
+	for (int i = 0; i < HASHES; ++i) {
+		bit = (h1 + i * h2) % bloom->bitsz;
+		bloom->bits[bit / 8] |= 1 << (bit % 8);
+	}
+
+	bloom->count++;
+}
+
+int
+bloom_has(const struct bloom *bloom, const char *id)
+{
+	assert(bloom);
+	assert(id);
+
+	uint64_t h1, h2, bit;
+
+	hash(id, &h1, &h2);
+
+	for (int i = 0; i < HASHES; ++i) {
+		bit = (h1 + i * h2) % bloom->bitsz;
+
+		if (!(bloom->bits[bit / 8] & (1 << (bit % 8))))
+			return 0;
+	}
+
+	return 1;
+}
+
+double
+bloom_rate(const struct bloom *bloom)
+{
+	assert(bloom);
+
+	if (!bloom->bitsz)
+		return 0;
+
+	return pow(1 - exp(-(double)HASHES * bloom->count / bloom->bitsz), HASHES);
+}
+
+double
+bloom_observed(const struct bloom *bloom)
+{
+	assert(bloom);
+
+	const unsigned long long total = bloom->negatives + bloom->falsepos;
+
+	return total ? (double)bloom->falsepos / total : 0;
+}
+
+size_t
+bloom_size(const struct bloom *bloom)
+{
+	assert(bloom);
+
+	return (bloom->bitsz + 7) / 8;
+}
+
+void
+bloom_finish(struct bloom *bloom)
+{
+	assert(bloom);
+
+	free(bloom->bits);
+	memset(bloom, 0, sizeof (*bloom));
+}
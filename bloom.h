@@ -0,0 +1,73 @@
+/*
+ * bloom.h -- membership filter of paste identifiers
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PASTER_BLOOM_H
+#define PASTER_BLOOM_H
+
+#include <stddef.h>
+
+/**
+ * Bloom filter: an identifier that was added is always reported, one that
+ * was not is reported with a small probability.
+ */
+struct bloom {
+	unsigned char *bits;            /* Bit array. */
+	size_t bitsz;                   /* Number of bits. */
+	size_t count;                   /* Identifiers added. */
+	size_t capacity;                /* Identifiers for the target rate. */
+	unsigned long long negatives;   /* Negative answers, counted by the user. */
+	unsigned long long falsepos;    /* Wrong positives, counted by the user. */
+};
+
+/**
+ * Create an empty filter sized for capacity identifiers.
+ */
+void
+bloom_init(struct bloom *, size_t);
+
+void
+bloom_add(struct bloom *, const char *);
+
+/**
+ * Returns 0 if the identifier was never added, 1 if it may have been.
+ */
+int
+bloom_has(const struct bloom *, const char *);
+
+/**
+ * Expected false positive rate for the current number of identifiers.
+ */
+double
+bloom_rate(const struct bloom *);
+
+/**
+ * Observed false positive rate: the wrong positive answers among all the
+ * lookups of identifiers that were not added.
+ */
+double
+bloom_observed(const struct bloom *);
+
+/**
+ * Memory used by the bit array in bytes.
+ */
+size_t
+bloom_size(const struct bloom *);
+
+void
+bloom_finish(struct bloom *);
+
+#endif /* !PASTER_BLOOM_H */
@@ -0,0 +1,242 @@
+/*
+ * cache.c -- LRU cache of recently accessed pastes
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+#include "paste.h"
+#include "util.h"
+
+struct cache_entry {
+	struct paste paste;
+	size_t size;                    /* Bytes accounted in the budget. */
+	time_t expires;                 /* Date after which it is invalid. */
+	struct cache_entry *next;       /* Next in the same bucket. */
+	struct cache_entry *newer;      /* Neighbours in the usage list. */
+	struct cache_entry *older;
+};
+
+static uint32_t
+hash(const char *id)
+{
+	uint32_t hash = 2166136261U;
+
+	for (; *id; ++id)
+		hash = (hash ^ (unsigned char)*id) * 16777619U;
+
+	return hash;
+}
+
+/*
+ * Entries are on the heap, copies handed out go to the arena of the paste if
+ * it has one. Only the short strings are copied, the code is shared.
+ */
+static void
+copy(struct paste *dst, struct paste *src)
+{
+	paste_reset(dst);
+	dst->id = paste_text(dst, src->id, strlen(src->id));
+	dst->title = paste_text(dst, src->title, strlen(src->title));
+	dst->author = paste_text(dst, src->author, strlen(src->author));
+	dst->language = paste_text(dst, src->language, strlen(src->language));
+	dst->timestamp = src->timestamp;
+	dst->visible = src->visible;
+	dst->duration = src->duration;
+	paste_share_code(dst, src);
+}
+
+static struct cache_entry **
+lookup(struct cache *cache, const char *id)
+{
+	struct cache_entry **e;
+
+	for (e = &cache->buckets[hash(id) & (cache->bucketsz - 1)]; *e; e = &(*e)->next)
+		if (strcmp((*e)->paste.id, id) == 0)
+			break;
+
+	return e;
+}
+
+static void
+detach(struct cache *cache, struct cache_entry *entry)
+{
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
+
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+
+	entry->newer = entry->older = NULL;
+}
+
+static void
+push(struct cache *cache, struct cache_entry *entry)
+{
+	entry->older = cache->newest;
+
+	if (cache->newest)
+		cache->newest->newer = entry;
+	else
+		cache->oldest = entry;
+
+	cache->newest = entry;
+}
+
+static void
+evict(struct cache *cache, struct cache_entry **slot)
+{
+	struct cache_entry *entry = *slot;
+
+	*slot = entry->next;
+	detach(cache, entry);
+	cache->size -= entry->size;
+	cache->entries--;
+	paste_finish(&entry->paste);
+	free(entry);
+}
+
+/*
+ * Double the number of buckets to keep them short as entries are added.
+ */
+static void
+grow(struct cache *cache)
+{
+	struct cache_entry **old = cache->buckets, *e, *next;
+	size_t oldsz = cache->bucketsz;
+	uint32_t h;
+
+	cache->bucketsz *= 2;
+	cache->buckets = ecalloc(cache->bucketsz, sizeof (*cache->buckets));
+
+	for (size_t i = 0; i < oldsz; ++i) {
+		for (e = old[i]; e; e = next) {
+			next = e->next;
+			h = hash(e->paste.id) & (cache->bucketsz - 1);
+			e->next = cache->buckets[h];
+			cache->buckets[h] = e;
+		}
+	}
+
+	free(old);
+}
+
+void
+cache_init(struct cache *cache, size_t max)
+{
+	assert(cache);
+
+	memset(cache, 0, sizeof (*cache));
+	cache->max = max;
+	cache->bucketsz = 64;
+	cache->buckets = ecalloc(cache->bucketsz, sizeof (*cache->buckets));
+}
+
+int
+cache_get(struct cache *cache, struct paste *paste, const char *id)
+{
+	assert(cache);
+	assert(paste);
+	assert(id);
+
+	struct cache_entry **slot, *entry;
+
+	if (!cache->max)
+		return -1;
+
+	if (!(entry = *(slot = lookup(cache, id)))) {
+		cache->misses++;
+		return -1;
+	}
+
+	if (entry->expires <= time(NULL)) {
+		evict(cache, slot);
+		cache->misses++;
+		return -1;
+	}
+
+	detach(cache, entry);
+	push(cache, entry);
+	copy(paste, &entry->paste);
+	cache->hits++;
+
+	return 0;
+}
+
+void
+cache_put(struct cache *cache, struct paste *paste)
+{
+	assert(cache);
+	assert(paste);
+	assert(paste->id);
+
+	struct cache_entry **slot, *entry;
+	const time_t expires = paste->timestamp + paste->duration;
+	size_t size;
+
+	if (!cache->max || expires <= time(NULL) || *lookup(cache, paste->id))
+		return;
+
+	size = sizeof (*entry) + paste->codesz + 1 +
+	    strlen(paste->id) + strlen(paste->title) +
+	    strlen(paste->author) + strlen(paste->language) + 4;
+
+	if (size > cache->max)
+		return;
+
+	while (cache->size + size > cache->max)
+		evict(cache, lookup(cache, cache->oldest->paste.id));
+
+	if (cache->entries >= cache->bucketsz)
+		grow(cache);
+
+	entry = ecalloc(1, sizeof (*entry));
+	copy(&entry->paste, paste);
+	entry->size = size;
+	entry->expires = expires;
+
+	slot = lookup(cache, paste->id);
+	entry->next = *slot;
+	*slot = entry;
+	push(cache, entry);
+	cache->size += size;
+	cache->entries++;
+}
+
+void
+cache_finish(struct cache *cache)
+{
+	assert(cache);
+
+	struct cache_entry *entry, *next;
+
+	for (entry = cache->newest; entry; entry = next) {
+		next = entry->older;
+		paste_finish(&entry->paste);
+		free(entry);
+	}
+
+	free(cache->buckets);
+	memset(cache, 0, sizeof (*cache));
+}
@@ -0,0 +1,64 @@
+/*
+ * cache.h -- LRU cache of recently accessed pastes
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PASTER_CACHE_H
+#define PASTER_CACHE_H
+
+#include <stddef.h>
+
+struct paste;
+
+/**
+ * Pastes kept in memory by identifier, the least recently used are evicted
+ * once their total size exceeds the budget and each one is only served
+ * until it expires.
+ */
+struct cache {
+	struct cache_entry **buckets;   /* Hash table by identifier. */
+	size_t bucketsz;                /* Number of buckets, a power of 2. */
+	size_t entries;                 /* Number of pastes cached. */
+	struct cache_entry *newest;     /* Head of the usage list. */
+	struct cache_entry *oldest;     /* Tail of the usage list. */
+	size_t size;                    /* Bytes used by the entries. */
+	size_t max;                     /* Budget in bytes, 0 to disable. */
+	unsigned long long hits;        /* Lookups served from memory. */
+	unsigned long long misses;      /* Lookups not found or expired. */
+};
+
+void
+cache_init(struct cache *, size_t);
+
+/**
+ * Copy the paste with the given identifier if it is cached and has not
+ * expired yet, its code is shared with the cache rather than copied.
+ *
+ * Returns -1 if not found.
+ */
+int
+cache_get(struct cache *, struct paste *, const char *);
+
+/**
+ * Store a copy of the paste sharing its code, it is not kept if it has
+ * already expired or if it does not fit in the budget alone.
+ */
+void
+cache_put(struct cache *, struct paste *);
+
+void
+cache_finish(struct cache *);
+
+#endif /* !PASTER_CACHE_H */
@@ -19,7 +19,18 @@
 #include "config.h"
 
 struct config config = {
-	.databasepath   = VARDIR "/paster/paster.db",
-	.themedir       = SHAREDIR "/paster/themes/minimal",
-	.verbosity      = 1
+	.databasepath    = VARDIR "/paster/paster.db",
+	.databaseprofile = "default",
+	.databaseengine  = "sqlite",
+	.databaseshards  = 1,
+	.databasebucket  = 0,
+	.themedir        = SHAREDIR "/paster/themes/minimal",
+	.verbosity       = 1,
+	.compression     = 1024,
+	.maxsize         = 0,
+	.cachesize       = 4194304,
+	.clearrows       = 1000,
+	.cleartime       = 100,
+	.commitwindow    = 0,
+	.commitrows      = 0
 };
@@ -20,11 +20,23 @@
 #define PASTER_CONFIG_H
 
 #include <limits.h>
+#include <stddef.h>
 
 extern struct config {
 	char themedir[PATH_MAX];
 	char databasepath[PATH_MAX];
+	char databaseprofile[32];
+	char databaseengine[16];
+	size_t databaseshards;
+	unsigned int databasebucket;
 	int verbosity;
+	size_t compression;
+	size_t maxsize;
+	size_t cachesize;
+	size_t clearrows;
+	unsigned int cleartime;
+	unsigned int commitwindow;
+	size_t commitrows;
 } config;
 
 #endif /* !PASTER_CONFIG_H */
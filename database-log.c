@@ -0,0 +1,907 @@
+/*
+ * database-log.c -- append-only log storage engine
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "database.h"
+#include "log.h"
+#include "paste.h"
+#include "util.h"
+
+#define MAGIC           "PASTERL1"      /* Start of the file. */
+#define MAGICSZ         8
+#define RECORD_MAGIC    0x50535452U     /* Start of every record. */
+#define ALIGN(n)        (((n) + 7) & ~(size_t)7)
+
+/*
+ * Pastes are appended to a single file as records and never modified,
+ * removing expired pastes rewrites the file with the other ones. Every
+ * process maps the file and indexes the records by identifier in memory,
+ * before each operation it indexes the records appended by the others
+ * since and starts over if the file was rewritten.
+ *
+ * Appending is serialized between processes with flock(2).
+ */
+struct record {
+	uint32_t magic;
+	uint32_t size;                  /* Including the padding. */
+	int64_t date;
+	int64_t duration;
+	uint32_t codesz;
+	uint16_t titlesz;
+	uint16_t authorsz;
+	uint16_t languagesz;
+	uint8_t idsz;
+	uint8_t visible;
+	/* Followed by id, title, author, language and code. */
+};
+
+struct view {
+	const struct record *record;
+	const char *id;
+	const char *title;
+	const char *author;
+	const char *language;
+	const char *code;
+};
+
+struct database_log {
+	char path[PATH_MAX];
+	int fd;
+	pthread_mutex_t mutex;          /* Protects fd against database_sync. */
+	ino_t ino;                      /* File the index describes. */
+	unsigned char *map;
+	size_t mapsz;
+	size_t end;                     /* Bytes of complete records. */
+	size_t *records;                /* Offsets in file order. */
+	size_t recordsz;
+	size_t recordcap;
+	size_t *slots;                  /* Record index + 1 by identifier. */
+	size_t slotsz;                  /* Power of 2. */
+	long long int changes;          /* Incremented whenever it is updated. */
+};
+
+/*
+ * Criteria of engine_search.
+ */
+struct filter {
+	const char *title;
+	const char *author;
+	const char *language;
+	char **words;
+	size_t wordsz;
+};
+
+static void
+view(const struct database_log *lg, size_t offset, struct view *v)
+{
+	const struct record *r = (const struct record *)(lg->map + offset);
+
+	v->record = r;
+	v->id = (const char *)(r + 1);
+	v->title = v->id + r->idsz;
+	v->author = v->title + r->titlesz;
+	v->language = v->author + r->authorsz;
+	v->code = v->language + r->languagesz;
+}
+
+static int
+expired(const struct record *r, time_t now)
+{
+	return r->date + r->duration <= now;
+}
+
+static uint64_t
+hash(const char *id, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	while (len--)
+		hash = (hash ^ (unsigned char)*id++) * 1099511628211ULL;
+
+	return hash;
+}
+
+/*
+ * Return the slot of the identifier, either the one of its record or the
+ * empty one where it would go.
+ */
+static size_t *
+slot(const struct database_log *lg, const char *id, size_t len)
+{
+	size_t i = hash(id, len) & (lg->slotsz - 1);
+	struct view v;
+
+	for (; lg->slots[i]; i = (i + 1) & (lg->slotsz - 1)) {
+		view(lg, lg->records[lg->slots[i] - 1], &v);
+
+		if (v.record->idsz == len && memcmp(v.id, id, len) == 0)
+			break;
+	}
+
+	return &lg->slots[i];
+}
+
+static void
+rehash(struct database_log *lg)
+{
+	struct view v;
+
+	free(lg->slots);
+	lg->slotsz = lg->slotsz ? lg->slotsz * 2 : 1024;
+	lg->slots = ecalloc(lg->slotsz, sizeof (*lg->slots));
+
+	for (size_t i = 0; i < lg->recordsz; ++i) {
+		view(lg, lg->records[i], &v);
+		*slot(lg, v.id, v.record->idsz) = i + 1;
+	}
+}
+
+static void
+add(struct database_log *lg, size_t offset)
+{
+	struct view v;
+
+	if (lg->recordsz == lg->recordcap) {
+		lg->recordcap = lg->recordcap ? lg->recordcap * 2 : 1024;
+
+		if (!(lg->records = realloc(lg->records, lg->recordcap * sizeof (*lg->records))))
+			die("abort: %s", strerror(errno));
+	}
+
+	lg->records[lg->recordsz++] = offset;
+
+	/* Keep the table at most half full. */
+	if (lg->recordsz * 2 > lg->slotsz)
+		rehash(lg);
+	else {
+		view(lg, offset, &v);
+		*slot(lg, v.id, v.record->idsz) = lg->recordsz;
+	}
+}
+
+static const struct record *
+find(const struct database_log *lg, const char *id, struct view *v)
+{
+	const size_t *s;
+
+	if (!lg->slotsz)
+		return NULL;
+	if (!*(s = slot(lg, id, strlen(id))))
+		return NULL;
+
+	view(lg, lg->records[*s - 1], v);
+
+	return v->record;
+}
+
+/*
+ * Forget everything about the file, before it is opened again.
+ */
+static void
+reset(struct database_log *lg)
+{
+	if (lg->map)
+		munmap(lg->map, lg->mapsz);
+	if (lg->fd >= 0)
+		close(lg->fd);
+
+	free(lg->records);
+	free(lg->slots);
+
+	lg->fd = -1;
+	lg->map = NULL;
+	lg->mapsz = lg->end = 0;
+	lg->records = lg->slots = NULL;
+	lg->recordsz = lg->recordcap = lg->slotsz = 0;
+	lg->changes++;
+}
+
+static int
+openfile(struct database_log *lg)
+{
+	struct stat st;
+
+	if ((lg->fd = open(lg->path, O_RDWR | O_APPEND | O_CREAT, 0644)) < 0)
+		goto err;
+
+	/* Another process may be creating the same file. */
+	if (flock(lg->fd, LOCK_EX) < 0 || fstat(lg->fd, &st) < 0)
+		goto err;
+	if (st.st_size == 0 && write(lg->fd, MAGIC, MAGICSZ) != MAGICSZ)
+		goto err;
+
+	flock(lg->fd, LOCK_UN);
+	lg->ino = st.st_ino;
+
+	return 0;
+
+err:
+	log_warn("database: %s: %s", lg->path, strerror(errno));
+
+	return -1;
+}
+
+/*
+ * Index the records from the end of the last complete one up to size, the
+ * last one may still be written by another process.
+ */
+static int
+scan(struct database_log *lg, size_t size)
+{
+	const struct record *r;
+	size_t used;
+
+	if (size > lg->mapsz) {
+		if (lg->map)
+			munmap(lg->map, lg->mapsz);
+
+		lg->mapsz = 0;
+
+		if ((lg->map = mmap(NULL, size, PROT_READ, MAP_SHARED, lg->fd, 0)) == MAP_FAILED) {
+			lg->map = NULL;
+			log_warn("database: %s: %s", lg->path, strerror(errno));
+			return -1;
+		}
+
+		lg->mapsz = size;
+	}
+
+	if (lg->end == 0) {
+		if (size < MAGICSZ || memcmp(lg->map, MAGIC, MAGICSZ) != 0) {
+			log_warn("database: %s: not a paste log", lg->path);
+			return -1;
+		}
+
+		lg->end = MAGICSZ;
+	}
+
+	while (lg->end + sizeof (*r) <= size) {
+		r = (const struct record *)(lg->map + lg->end);
+		used = sizeof (*r) + r->idsz + r->titlesz + r->authorsz +
+		    r->languagesz + (size_t)r->codesz;
+
+		if (r->magic != RECORD_MAGIC || r->size != ALIGN(used) || r->size > size - lg->end)
+			break;
+
+		add(lg, lg->end);
+		lg->end += r->size;
+		lg->changes++;
+	}
+
+	return 0;
+}
+
+/*
+ * Catch up with the other processes.
+ */
+static int
+refresh(struct database_log *lg)
+{
+	struct stat st;
+	int rc;
+
+	if (stat(lg->path, &st) < 0) {
+		log_warn("database: %s: %s", lg->path, strerror(errno));
+		return -1;
+	}
+
+	/* Rewritten without the expired pastes. */
+	if (st.st_ino != lg->ino) {
+		pthread_mutex_lock(&lg->mutex);
+		reset(lg);
+		rc = openfile(lg);
+		pthread_mutex_unlock(&lg->mutex);
+
+		if (rc < 0 || fstat(lg->fd, &st) < 0)
+			return -1;
+	}
+
+	if ((size_t)st.st_size > lg->end)
+		return scan(lg, st.st_size);
+
+	return 0;
+}
+
+/*
+ * Take the write lock on the current file, up to date and without the
+ * incomplete record a crash may have left.
+ */
+static int
+lock(struct database_log *lg)
+{
+	struct stat st;
+
+	for (;;) {
+		if (flock(lg->fd, LOCK_EX) < 0)
+			goto err;
+		if (stat(lg->path, &st) < 0)
+			goto err;
+		if (st.st_ino == lg->ino)
+			break;
+
+		flock(lg->fd, LOCK_UN);
+
+		if (refresh(lg) < 0)
+			return -1;
+	}
+
+	if (refresh(lg) < 0)
+		goto unlock;
+	if (lg->end < (size_t)st.st_size && ftruncate(lg->fd, lg->end) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	log_warn("database: %s: %s", lg->path, strerror(errno));
+
+unlock:
+	flock(lg->fd, LOCK_UN);
+
+	return -1;
+}
+
+static char *
+text(const char *s, size_t len)
+{
+	char *ret = ecalloc(1, len + 1);
+
+	memcpy(ret, s, len);
+
+	return ret;
+}
+
+static void
+fill(struct paste *paste, const struct view *v)
+{
+	paste->id = paste_text(paste, v->id, v->record->idsz);
+	paste->title = paste_text(paste, v->title, v->record->titlesz);
+	paste->author = paste_text(paste, v->author, v->record->authorsz);
+	paste->language = paste_text(paste, v->language, v->record->languagesz);
+	paste->timestamp = v->record->date;
+	paste->visible = v->record->visible;
+	paste->duration = v->record->duration;
+	paste->code = text(v->code, v->record->codesz);
+	paste->codesz = v->record->codesz;
+	paste->encoding = PASTE_ENCODING_IDENTITY;
+}
+
+/*
+ * Compare an identifier from the file with a NUL terminated one.
+ */
+static int
+idcmp(const char *id, size_t len, const char *other)
+{
+	const size_t otherlen = strlen(other);
+	int cmp;
+
+	if ((cmp = memcmp(id, other, len < otherlen ? len : otherlen)) != 0)
+		return cmp;
+
+	return len < otherlen ? -1 : len > otherlen;
+}
+
+/*
+ * Most recent first, then by identifier like the SQLite engine.
+ */
+static int
+cmp(const void *v1, const void *v2)
+{
+	const struct view *a = v1, *b = v2;
+	const size_t alen = a->record->idsz, blen = b->record->idsz;
+	int rc;
+
+	if (a->record->date != b->record->date)
+		return a->record->date < b->record->date ? 1 : -1;
+	if ((rc = memcmp(a->id, b->id, alen < blen ? alen : blen)) != 0)
+		return -rc;
+
+	return alen < blen ? 1 : alen > blen ? -1 : 0;
+}
+
+/*
+ * Case insensitive search of needle in the len bytes at haystack.
+ */
+static int
+contains(const char *haystack, size_t len, const char *needle)
+{
+	const size_t needlesz = strlen(needle);
+	size_t i;
+
+	if (needlesz > len)
+		return 0;
+
+	for (size_t start = 0; start + needlesz <= len; ++start) {
+		for (i = 0; i < needlesz; ++i)
+			if (tolower((unsigned char)haystack[start + i]) != tolower((unsigned char)needle[i]))
+				break;
+		if (i == needlesz)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int
+match(const struct view *v, const struct filter *f)
+{
+	const struct record *r = v->record;
+
+	if (f->title && !contains(v->title, r->titlesz, f->title))
+		return 0;
+	if (f->author && !contains(v->author, r->authorsz, f->author))
+		return 0;
+	if (f->language && (r->languagesz != strlen(f->language) ||
+	    memcmp(v->language, f->language, r->languagesz) != 0))
+		return 0;
+
+	for (size_t i = 0; i < f->wordsz; ++i)
+		if (!contains(v->title, r->titlesz, f->words[i]) &&
+		    !contains(v->code, r->codesz, f->words[i]))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Rows of a listing, borrowed from the map which stays the same until the
+ * next operation refreshes it.
+ */
+struct listing {
+	struct view *rows;
+	size_t rowsz;
+	size_t next;
+};
+
+/*
+ * Return the index of the first record more recent than date, records are
+ * appended in date order.
+ */
+static size_t
+seek(const struct database_log *lg, time_t date)
+{
+	size_t lo = 0, hi = lg->recordsz, mid;
+	struct view v;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		view(lg, lg->records[mid], &v);
+
+		if (v.record->date > date)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo;
+}
+
+/*
+ * Start a listing of the most recent public pastes older than after and
+ * matching the filter if any.
+ */
+static int
+walk(struct database_log *lg,
+     struct database_cursor *cursor,
+     const struct paste *after,
+     const struct filter *f)
+{
+	struct listing *ls;
+	struct view *found = NULL, v;
+	size_t foundsz = 0, foundcap = 0;
+	const size_t max = cursor->max;
+	const time_t now = time(NULL);
+
+	if (refresh(lg) < 0)
+		return -1;
+
+	/* Next pages start from the records of the last date shown. */
+	for (size_t i = after ? seek(lg, after->timestamp) : lg->recordsz; i-- > 0; ) {
+		view(lg, lg->records[i], &v);
+
+		/*
+		 * Records are appended in date order, once there are enough
+		 * only the ones of the same second may still come first.
+		 */
+		if (foundsz >= max && (!max || v.record->date < found[foundsz - 1].record->date))
+			break;
+		if (!v.record->visible || expired(v.record, now))
+			continue;
+		if (after && (v.record->date > after->timestamp || (v.record->date == after->timestamp &&
+		    idcmp(v.id, v.record->idsz, after->id) >= 0)))
+			continue;
+		if (f && !match(&v, f))
+			continue;
+
+		if (foundsz == foundcap) {
+			foundcap = foundcap ? foundcap * 2 : 16;
+
+			if (!(found = realloc(found, foundcap * sizeof (*found))))
+				die("abort: %s", strerror(errno));
+		}
+
+		found[foundsz++] = v;
+	}
+
+	if (foundsz)
+		qsort(found, foundsz, sizeof (*found), cmp);
+
+	cursor->data = ls = ecalloc(1, sizeof (*ls));
+	ls->rows = found;
+	ls->rowsz = foundsz < max ? foundsz : max;
+
+	return 0;
+}
+
+static void
+borrow(const char *s, size_t len, struct database_text *text)
+{
+	text->data = s;
+	text->len = len;
+}
+
+static int
+engine_cursor_next(struct database_cursor *cursor)
+{
+	struct listing *ls = cursor->data;
+	struct database_row *row = &cursor->row;
+	const struct view *v;
+
+	if (ls->next == ls->rowsz)
+		return 0;
+
+	v = &ls->rows[ls->next++];
+	memset(row, 0, sizeof (*row));
+	borrow(v->id, v->record->idsz, &row->id);
+	borrow(v->title, v->record->titlesz, &row->title);
+	borrow(v->author, v->record->authorsz, &row->author);
+	borrow(v->language, v->record->languagesz, &row->language);
+	row->timestamp = v->record->date;
+	row->visible = v->record->visible;
+	row->duration = v->record->duration;
+
+	return 1;
+}
+
+static void
+engine_cursor_finish(struct database_cursor *cursor)
+{
+	struct listing *ls = cursor->data;
+
+	if (!ls)
+		return;
+
+	free(ls->rows);
+	free(ls);
+	cursor->data = NULL;
+}
+
+static void
+engine_finish(struct database *);
+
+static int
+engine_open(struct database *base, const char *path)
+{
+	struct database_log *lg;
+
+	log_info("database: opening log %s", path);
+
+	base->data = lg = ecalloc(1, sizeof (*lg));
+	lg->fd = -1;
+	pthread_mutex_init(&lg->mutex, NULL);
+	snprintf(lg->path, sizeof (lg->path), "%s", path);
+
+	if (openfile(lg) < 0 || refresh(lg) < 0) {
+		engine_finish(base);
+		return -1;
+	}
+
+	base->grouped = !base->maintenance && (config.commitwindow || config.commitrows);
+
+	log_debug("database: %zu pastes in log", lg->recordsz);
+
+	return 0;
+}
+
+static int
+engine_get(struct database *base, struct paste *paste, const char *id, enum paste_encoding accept)
+{
+	struct database_log *lg = base->data;
+	struct view v;
+
+	(void)accept;
+
+	paste_reset(paste);
+
+	if (refresh(lg) < 0)
+		return -1;
+	if (!find(lg, id, &v) || expired(v.record, time(NULL)))
+		return -1;
+
+	fill(paste, &v);
+
+	return 0;
+}
+
+static int
+engine_insert(struct database *base, struct paste *paste, const char *code, size_t len)
+{
+	struct database_log *lg = base->data;
+	struct record r = {0};
+	struct view v;
+	struct iovec iov[7];
+	static const char padding[8];
+	size_t used;
+	long long int changes;
+	int tries = 0, rc = -1;
+
+	if (strlen(paste->title) > UINT16_MAX || strlen(paste->author) > UINT16_MAX ||
+	    strlen(paste->language) > UINT16_MAX || len > UINT32_MAX - UINT16_MAX * 4) {
+		log_warn("database: error (insert): paste too large for the log");
+		return -1;
+	}
+
+	if (lock(lg) < 0)
+		return -1;
+
+	do {
+		paste_create_id(paste);
+	} while (find(lg, paste->id, &v) && ++tries < 8);
+
+	if (tries == 8) {
+		log_warn("database: error (insert): no free identifier found");
+		goto end;
+	}
+
+	r.magic = RECORD_MAGIC;
+	r.date = time(NULL);
+	r.duration = paste->duration;
+	r.codesz = len;
+	r.idsz = strlen(paste->id);
+	r.titlesz = strlen(paste->title);
+	r.authorsz = strlen(paste->author);
+	r.languagesz = strlen(paste->language);
+	r.visible = paste->visible != 0;
+
+	used = sizeof (r) + r.idsz + r.titlesz + r.authorsz + r.languagesz + len;
+	r.size = ALIGN(used);
+
+	/* The code is written from the caller's buffer. */
+	iov[0] = (struct iovec) { &r, sizeof (r) };
+	iov[1] = (struct iovec) { paste->id, r.idsz };
+	iov[2] = (struct iovec) { paste->title, r.titlesz };
+	iov[3] = (struct iovec) { paste->author, r.authorsz };
+	iov[4] = (struct iovec) { paste->language, r.languagesz };
+	iov[5] = (struct iovec) { (void *)code, len };
+	iov[6] = (struct iovec) { (void *)padding, r.size - used };
+
+	if (writev(lg->fd, iov, NELEM(iov)) != (ssize_t)r.size) {
+		log_warn("database: error (insert): %s", strerror(errno));
+		ftruncate(lg->fd, lg->end);
+		goto end;
+	}
+
+	/* With group commit, database_sync does it later. */
+	if (!base->grouped && fdatasync(lg->fd) < 0)
+		log_warn("database: error (insert): %s", strerror(errno));
+
+	rc = 0;
+
+end:
+	flock(lg->fd, LOCK_UN);
+
+	/* Like SQLite's data version, only changes by others count. */
+	if (rc == 0) {
+		changes = lg->changes;
+		refresh(lg);
+		lg->changes = changes;
+	}
+
+	return rc;
+}
+
+static int
+engine_cursor_recents(struct database *base,
+                      struct database_cursor *cursor,
+                      const struct paste *after)
+{
+	return walk(base->data, cursor, after, NULL);
+}
+
+static int
+engine_cursor_search(struct database *base,
+                     struct database_cursor *cursor,
+                     const char *title,
+                     const char *author,
+                     const char *language,
+                     const char *query,
+                     const struct paste *after)
+{
+	struct filter f = {
+		.title = title && *title ? title : NULL,
+		.author = author && *author ? author : NULL,
+		.language = language && *language ? language : NULL
+	};
+	char *words = NULL, *word, *p;
+	int rc;
+
+	/* Every word must be in the title or the code. */
+	if (query) {
+		p = words = estrdup(query);
+		f.words = ecalloc(strlen(query) / 2 + 1, sizeof (*f.words));
+
+		while ((word = strsep(&p, " \t\r\n")))
+			if (*word)
+				f.words[f.wordsz++] = word;
+	}
+
+	rc = walk(base->data, cursor, after, &f);
+
+	free(f.words);
+	free(words);
+
+	return rc;
+}
+
+/*
+ * Rewrite the file without the expired pastes, other processes notice the
+ * new file at their next operation.
+ */
+static int
+engine_clear(struct database *base)
+{
+	struct database_log *lg = base->data;
+	struct view v;
+	char tmp[PATH_MAX + 4];
+	const time_t now = time(NULL);
+	size_t start = 0, runsz = 0;
+	int fd = -1, removed = 0;
+
+	if (lock(lg) < 0)
+		return -1;
+
+	for (size_t i = 0; i < lg->recordsz; ++i) {
+		view(lg, lg->records[i], &v);
+		removed += expired(v.record, now);
+	}
+
+	if (!removed)
+		goto end;
+
+	snprintf(tmp, sizeof (tmp), "%s.tmp", lg->path);
+
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		goto err;
+	if (write(fd, MAGIC, MAGICSZ) != MAGICSZ)
+		goto err;
+
+	/* Copy the live records by runs of adjacent ones. */
+	for (size_t i = 0; i <= lg->recordsz; ++i) {
+		if (i < lg->recordsz) {
+			view(lg, lg->records[i], &v);
+
+			if (!expired(v.record, now)) {
+				if (!runsz)
+					start = lg->records[i];
+
+				runsz += v.record->size;
+				continue;
+			}
+		}
+
+		if (runsz && write(fd, lg->map + start, runsz) != (ssize_t)runsz)
+			goto err;
+
+		runsz = 0;
+	}
+
+	if (fsync(fd) < 0 || close(fd) < 0 || rename(tmp, lg->path) < 0) {
+		fd = -1;
+		goto err;
+	}
+
+	fd = -1;
+
+end:
+	flock(lg->fd, LOCK_UN);
+	log_info("database: removed %d expired pastes", removed);
+
+	return refresh(lg) < 0 ? -1 : removed;
+
+err:
+	log_warn("database: error (clear): %s", strerror(errno));
+
+	if (fd >= 0)
+		close(fd);
+
+	unlink(tmp);
+	flock(lg->fd, LOCK_UN);
+
+	return -1;
+}
+
+static void
+engine_finish(struct database *base)
+{
+	struct database_log *lg = base->data;
+
+	if (!lg)
+		return;
+
+	reset(lg);
+	pthread_mutex_destroy(&lg->mutex);
+	free(lg);
+	base->data = NULL;
+}
+
+static long long int
+engine_version(struct database *base)
+{
+	struct database_log *lg = base->data;
+
+	if (refresh(lg) < 0)
+		return -1;
+
+	return lg->changes;
+}
+
+static void
+engine_sync(struct database *base)
+{
+	struct database_log *lg = base->data;
+
+	/* The file may be replaced meanwhile, the new one is already synced. */
+	pthread_mutex_lock(&lg->mutex);
+
+	if (lg->fd >= 0 && fdatasync(lg->fd) < 0)
+		log_warn("database: error (sync): %s", strerror(errno));
+
+	pthread_mutex_unlock(&lg->mutex);
+}
+
+const struct database_engine database_engine_log = {
+	.name           = "log",
+	.open           = engine_open,
+	.get            = engine_get,
+	.insert         = engine_insert,
+	.cursor_recents = engine_cursor_recents,
+	.cursor_search  = engine_cursor_search,
+	.cursor_next    = engine_cursor_next,
+	.cursor_finish  = engine_cursor_finish,
+	.clear          = engine_clear,
+	.finish         = engine_finish,
+	.version        = engine_version,
+	.sync           = engine_sync
+};
@@ -0,0 +1,2241 @@
+/*
+ * database-sqlite.c -- SQLite storage engine
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include "bloom.h"
+#include "config.h"
+#include "database-sqlite.h"
+#include "database.h"
+#include "gzip.h"
+#include "log.h"
+#include "paste.h"
+#include "sha256.h"
+#include "util.h"
+
+#include "sql/bucket-create.h"
+#include "sql/bucket-drop.h"
+#include "sql/bucket-find.h"
+#include "sql/bucket-insert.h"
+#include "sql/buckets.h"
+#include "sql/clear.h"
+#include "sql/count.h"
+#include "sql/data-version.h"
+#include "sql/fulltext.h"
+#include "sql/get.h"
+#include "sql/ids-added.h"
+#include "sql/ids-last.h"
+#include "sql/ids-prune.h"
+#include "sql/ids.h"
+#include "sql/init.h"
+#include "sql/insert-body.h"
+#include "sql/insert.h"
+#include "sql/recents.h"
+#include "sql/search.h"
+#include "sql/share-body.h"
+#include "sql/stream.h"
+#include "sql/substring.h"
+#include "sql/upgrade-1.h"
+#include "sql/upgrade-2.h"
+#include "sql/upgrade-3.h"
+#include "sql/upgrade-4.h"
+#include "sql/upgrade-5.h"
+#include "sql/upgrade-6.h"
+#include "sql/upgrade-7.h"
+#include "sql/upgrade-8.h"
+#include "sql/upgrade-9.h"
+#include "sql/upgrade-10.h"
+#include "sql/upgrade-11.h"
+
+#define CHAR(sql) (const char *)(sql)
+
+/*
+ * Expired pastes are deleted by chunks of CLEAR_CHUNK rows, as many as the
+ * configured budget allows in one transaction, then the write lock is
+ * released for CLEAR_YIELD milliseconds to let pending inserts through.
+ */
+#define CLEAR_CHUNK 64
+#define CLEAR_YIELD 10
+
+/* Smallest number of identifiers a membership filter is sized for. */
+#define FILTER_MIN 1024
+
+/*
+ * Seconds the journal of new identifiers is kept, the filter of a process
+ * which did not read it meanwhile is filled again completely.
+ */
+#define FILTER_JOURNAL 3600
+
+enum stmt {
+	STMT_BUCKET_CREATE,
+	STMT_BUCKET_DROP,
+	STMT_BUCKET_FIND,
+	STMT_BUCKET_INSERT,
+	STMT_BUCKETS,
+	STMT_CLEAR,
+	STMT_COUNT,
+	STMT_DATA_VERSION,
+	STMT_FULLTEXT,
+	STMT_GET,
+	STMT_IDS,
+	STMT_IDS_ADDED,
+	STMT_IDS_LAST,
+	STMT_IDS_PRUNE,
+	STMT_INSERT,
+	STMT_INSERT_BODY,
+	STMT_RECENTS,
+	STMT_SEARCH,
+	STMT_SHARE_BODY,
+	STMT_STREAM,
+	STMT_SUBSTRING,
+	STMT_LAST
+};
+
+static const unsigned char * const queries[] = {
+	[STMT_BUCKET_CREATE] = sql_bucket_create,
+	[STMT_BUCKET_DROP]   = sql_bucket_drop,
+	[STMT_BUCKET_FIND]   = sql_bucket_find,
+	[STMT_BUCKET_INSERT] = sql_bucket_insert,
+	[STMT_BUCKETS]       = sql_buckets,
+	[STMT_CLEAR]         = sql_clear,
+	[STMT_COUNT]         = sql_count,
+	[STMT_DATA_VERSION]  = sql_data_version,
+	[STMT_FULLTEXT]      = sql_fulltext,
+	[STMT_GET]           = sql_get,
+	[STMT_IDS]           = sql_ids,
+	[STMT_IDS_ADDED]     = sql_ids_added,
+	[STMT_IDS_LAST]      = sql_ids_last,
+	[STMT_IDS_PRUNE]     = sql_ids_prune,
+	[STMT_INSERT]        = sql_insert,
+	[STMT_INSERT_BODY]   = sql_insert_body,
+	[STMT_RECENTS]       = sql_recents,
+	[STMT_SEARCH]        = sql_search,
+	[STMT_SHARE_BODY]    = sql_share_body,
+	[STMT_STREAM]        = sql_stream,
+	[STMT_SUBSTRING]     = sql_substring
+};
+
+/*
+ * Statements run by the read-only connection, the others need the writer.
+ *
+ * The data version stays on the writer, it ignores the commits of its own
+ * connection so that only the other processes invalidate the filter and the
+ * recents snapshot while the reader would see ours too.
+ */
+static int
+reading(enum stmt which)
+{
+	switch (which) {
+	case STMT_BUCKET_FIND:
+	case STMT_BUCKETS:
+	case STMT_COUNT:
+	case STMT_FULLTEXT:
+	case STMT_GET:
+	case STMT_IDS:
+	case STMT_IDS_ADDED:
+	case STMT_IDS_LAST:
+	case STMT_RECENTS:
+	case STMT_SEARCH:
+	case STMT_STREAM:
+	case STMT_SUBSTRING:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Schema upgrades, the database user_version is the number of upgrades
+ * already applied.
+ */
+static const unsigned char * const upgrades[] = {
+	sql_upgrade_1,
+	sql_upgrade_2,
+	sql_upgrade_3,
+	sql_upgrade_4,
+	sql_upgrade_5,
+	sql_upgrade_6,
+	sql_upgrade_7,
+	sql_upgrade_8,
+	sql_upgrade_9,
+	sql_upgrade_10,
+	sql_upgrade_11
+};
+
+/* Upgrade which needs incremental vacuum enabled first. */
+#define UPGRADE_VACUUM 10
+
+/*
+ * Connection tuning applied at open, selected by name from the configuration.
+ *
+ * All profiles except legacy use WAL so that readers are never blocked by a
+ * writer committing a paste. The read-only connection serving pages has its
+ * own page cache and memory map sizes, it never holds dirty pages so it can
+ * use more of both.
+ */
+static const struct profile {
+	const char *name;
+	const char *journal;            /* PRAGMA journal_mode */
+	const char *synchronous;        /* PRAGMA synchronous */
+	long long int cachesize;        /* PRAGMA cache_size (negative is KiB) */
+	long long int mmapsize;         /* PRAGMA mmap_size (bytes) */
+	const char *tempstore;          /* PRAGMA temp_store */
+	int checkpoint;                 /* PRAGMA wal_autocheckpoint (pages) */
+	long long int readcachesize;    /* PRAGMA cache_size of the reader */
+	long long int readmmapsize;     /* PRAGMA mmap_size of the reader */
+} profiles[] = {
+	{ "default",    "WAL",          "NORMAL",       -8192,          67108864,       "MEMORY",       1000,   -16384,         268435456       },
+	{ "safe",       "WAL",          "FULL",         -2048,          0,              "DEFAULT",      1000,   -8192,          0               },
+	{ "fast",       "WAL",          "NORMAL",       -65536,         268435456,      "MEMORY",       4000,   -131072,        1073741824      },
+	{ "legacy",     "DELETE",       "FULL",         -2048,          0,              "DEFAULT",      1000,   -2048,          0               }
+};
+
+static const struct profile *
+profile(const char *name)
+{
+	for (size_t i = 0; i < NELEM(profiles); ++i)
+		if (strcmp(profiles[i].name, name) == 0)
+			return &profiles[i];
+
+	return NULL;
+}
+
+static int
+tune(struct database_shard *sh, const struct profile *prof)
+{
+	char sql[256];
+
+	/* auto_vacuum only applies to a new file if set before anything else. */
+	snprintf(sql, sizeof (sql),
+	    "PRAGMA auto_vacuum = INCREMENTAL;"
+	    "PRAGMA journal_mode = %s;"
+	    "PRAGMA synchronous = %s;"
+	    "PRAGMA cache_size = %lld;"
+	    "PRAGMA mmap_size = %lld;"
+	    "PRAGMA temp_store = %s;"
+	    "PRAGMA wal_autocheckpoint = %d;",
+	    prof->journal, prof->synchronous, prof->cachesize,
+	    prof->mmapsize, prof->tempstore, prof->checkpoint);
+
+	return sqlite3_exec(sh->handle, sql, NULL, NULL, NULL) == SQLITE_OK ? 0 : -1;
+}
+
+static int
+tune_reader(struct database_shard *sh, const struct profile *prof)
+{
+	char sql[256];
+
+	snprintf(sql, sizeof (sql),
+	    "PRAGMA query_only = ON;"
+	    "PRAGMA cache_size = %lld;"
+	    "PRAGMA mmap_size = %lld;"
+	    "PRAGMA temp_store = %s;",
+	    prof->readcachesize, prof->readmmapsize, prof->tempstore);
+
+	return sqlite3_exec(sh->reader, sql, NULL, NULL, NULL) == SQLITE_OK ? 0 : -1;
+}
+
+/*
+ * SQL function body_text(code, encoding) returning the plain text of a body,
+ * used by the full text index.
+ */
+static void
+body_text(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+	(void)argc;
+
+	char *text;
+	size_t len;
+
+	/* Bodies written by chunks are blobs, index them as text anyway. */
+	if (sqlite3_value_int(argv[1]) == PASTE_ENCODING_IDENTITY) {
+		if (sqlite3_value_type(argv[0]) == SQLITE_BLOB)
+			sqlite3_result_text(ctx, (const char *)sqlite3_value_text(argv[0]),
+			    sqlite3_value_bytes(argv[0]), SQLITE_TRANSIENT);
+		else
+			sqlite3_result_value(ctx, argv[0]);
+
+		return;
+	}
+
+	text = gzip_decompress(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]), &len);
+
+	if (!text)
+		sqlite3_result_error(ctx, "invalid compressed body", -1);
+	else
+		sqlite3_result_text(ctx, text, len, free);
+}
+
+/*
+ * SQL function sha256(text) returning the hexadecimal digest used to key
+ * bodies, only needed when migrating existing ones.
+ */
+static void
+sha256(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+	(void)argc;
+
+	char hex[SHA256_HEX_LENGTH];
+
+	sha256_hex(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]), hex);
+	sqlite3_result_text(ctx, hex, -1, SQLITE_TRANSIENT);
+}
+
+/*
+ * Read an integer pragma such as user_version or freelist_count.
+ */
+static int
+pragma(struct database_shard *sh, const char *name)
+{
+	sqlite3_stmt *stmt = NULL;
+	char sql[64];
+	int ret = -1;
+
+	snprintf(sql, sizeof (sql), "PRAGMA %s", name);
+
+	if (sqlite3_prepare_v2(sh->handle, sql, -1, &stmt, NULL) != SQLITE_OK)
+		return -1;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		ret = sqlite3_column_int(stmt, 0);
+
+	sqlite3_finalize(stmt);
+
+	return ret;
+}
+
+/*
+ * Bring an existing database to the current schema. The version is read
+ * within the write transaction because the cleanup thread may open the
+ * database at the same time.
+ *
+ * Files created before incremental vacuum was enabled need a full VACUUM
+ * first, new ones already have it from tune(). It cannot run inside a
+ * transaction so the upgrades before are committed, then the file is
+ * converted and the upgrades start over from there. Other processes wait
+ * for the last commit before they open their reader.
+ */
+static int
+upgrade(struct database_shard *sh)
+{
+	char sql[64];
+	int current, i;
+
+	for (;;) {
+		if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
+			return -1;
+		if ((current = pragma(sh, "user_version")) < 0)
+			goto err;
+
+		for (i = current; i < (int)NELEM(upgrades); ++i) {
+			if (i + 1 == UPGRADE_VACUUM && pragma(sh, "auto_vacuum") != 2)
+				break;
+
+			log_info("database: upgrading schema to version %d", i + 1);
+
+			if (sqlite3_exec(sh->handle, CHAR(upgrades[i]), NULL, NULL, NULL) != SQLITE_OK)
+				goto err;
+		}
+
+		if (i != current) {
+			snprintf(sql, sizeof (sql), "PRAGMA user_version = %d", i);
+
+			if (sqlite3_exec(sh->handle, sql, NULL, NULL, NULL) != SQLITE_OK)
+				goto err;
+		}
+		if (sqlite3_exec(sh->handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+			goto err;
+		if (i == (int)NELEM(upgrades))
+			return 0;
+
+		log_info("database: enabling incremental vacuum, this may take a while");
+
+		if (sqlite3_exec(sh->handle, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM",
+		    NULL, NULL, NULL) != SQLITE_OK) {
+			log_warn("database: error (vacuum): %s", sqlite3_errmsg(sh->handle));
+			return -1;
+		}
+	}
+
+err:
+	log_warn("database: error (upgrade): %s", sqlite3_errmsg(sh->handle));
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+	return -1;
+}
+
+/*
+ * Statements are compiled once in database_open and kept until
+ * database_finish, each user only needs to rebind its parameters.
+ */
+static int
+prepare(struct database_shard *sh)
+{
+	sh->stmts = ecalloc(STMT_LAST, sizeof (sqlite3_stmt *));
+
+	for (size_t i = 0; i < STMT_LAST; ++i)
+		if (sqlite3_prepare_v3(reading(i) ? sh->reader : sh->handle, CHAR(queries[i]), -1,
+		    SQLITE_PREPARE_PERSISTENT, (sqlite3_stmt **)&sh->stmts[i], NULL) != SQLITE_OK)
+			return -1;
+
+	return 0;
+}
+
+static sqlite3_stmt *
+statement(struct database_sqlite *db, struct database_shard *sh, enum stmt which)
+{
+	sqlite3_stmt *stmt = sh->stmts[which];
+
+	assert(stmt);
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	db->hits++;
+
+	return stmt;
+}
+
+/*
+ * Reset the statement as soon as we're done with it, otherwise it keeps its
+ * read transaction open until the next use.
+ */
+static void
+release(sqlite3_stmt *stmt)
+{
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+static char *
+copy(sqlite3_stmt *stmt, int col, const struct paste *paste)
+{
+	const char *s = (const char *)sqlite3_column_text(stmt, col);
+
+	return paste_text(paste, s ? s : "", s ? (size_t)sqlite3_column_bytes(stmt, col) : 0);
+}
+
+static void
+convert(sqlite3_stmt *stmt, struct paste *paste)
+{
+	paste->id = copy(stmt, 0, paste);
+	paste->title = copy(stmt, 1, paste);
+	paste->author = copy(stmt, 2, paste);
+	paste->language = copy(stmt, 3, paste);
+	paste->timestamp = sqlite3_column_int64(stmt, 4);
+	paste->visible = sqlite3_column_int(stmt, 5);
+	paste->duration = sqlite3_column_int64(stmt, 6);
+}
+
+/*
+ * Turn user input into a FTS5 query where every word is quoted so that
+ * operators and punctuation are matched literally, words are implicitly
+ * joined with AND. Returns NULL if there is no word at all.
+ */
+static char *
+fulltext(const char *query)
+{
+	char *ret, *p;
+	int inword = 0;
+
+	/* Worst case: single quote characters separated by spaces. */
+	p = ret = ecalloc(1, strlen(query) * 5 + 1);
+
+	for (; *query; ++query) {
+		if (isspace((unsigned char)*query)) {
+			if (inword)
+				*p++ = '"';
+
+			inword = 0;
+			continue;
+		}
+		if (!inword) {
+			if (p != ret)
+				*p++ = ' ';
+
+			*p++ = '"';
+			inword = 1;
+		}
+		if (*query == '"')
+			*p++ = '"';
+
+		*p++ = *query;
+	}
+
+	if (inword)
+		*p++ = '"';
+	if (p == ret) {
+		free(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+static char *
+contains(const char *text)
+{
+	char *ret = ecalloc(1, strlen(text) + 3);
+
+	sprintf(ret, "%%%s%%", text);
+
+	return ret;
+}
+
+/*
+ * Only terms of at least three characters without LIKE wildcards can be
+ * looked up in the trigram index, the others are left to the LIKE filters.
+ */
+static int
+indexable(const char *text)
+{
+	size_t chars = 0;
+
+	if (!text || strpbrk(text, "%_"))
+		return 0;
+
+	/* Count UTF-8 characters, not bytes. */
+	for (; *text; ++text)
+		if ((*text & 0xc0) != 0x80)
+			chars++;
+
+	return chars >= 3;
+}
+
+static void
+term(char **p, const char *column, const char *text)
+{
+	*p += sprintf(*p, "%s : \"", column);
+
+	for (; *text; ++text) {
+		if (*text == '"')
+			*(*p)++ = '"';
+
+		*(*p)++ = *text;
+	}
+
+	*(*p)++ = '"';
+}
+
+/*
+ * Build a trigram query matching title and author substrings. Returns NULL
+ * if none of them can use the index.
+ */
+static char *
+trigram(const char *title, const char *author)
+{
+	char *ret, *p;
+	size_t len = 64;
+
+	if (!indexable(title))
+		title = NULL;
+	if (!indexable(author))
+		author = NULL;
+	if (!title && !author)
+		return NULL;
+
+	len += title ? strlen(title) * 2 : 0;
+	len += author ? strlen(author) * 2 : 0;
+	p = ret = ecalloc(1, len);
+
+	if (title)
+		term(&p, "title", title);
+	if (title && author)
+		p += sprintf(p, " AND ");
+	if (author)
+		term(&p, "author", author);
+
+	return ret;
+}
+
+/*
+ * Read the data version of a shard, it changes whenever another connection
+ * commits into it.
+ */
+static int
+version(struct database_sqlite *db, struct database_shard *sh, long long int *v)
+{
+	sqlite3_stmt *stmt = statement(db, sh, STMT_DATA_VERSION);
+
+	if (sqlite3_step(stmt) != SQLITE_ROW) {
+		log_warn("database: error (version): %s", sqlite3_errmsg(sh->handle));
+		release(stmt);
+		return -1;
+	}
+
+	*v = sqlite3_column_int64(stmt, 0);
+	release(stmt);
+
+	return 0;
+}
+
+/*
+ * Fill the filter of the shard with every identifier it stores, with room
+ * for as many new ones.
+ */
+static int
+load(struct database_sqlite *db, struct database_shard *sh)
+{
+	sqlite3_stmt *stmt;
+	unsigned long long negatives = sh->bloom.negatives, falsepos = sh->bloom.falsepos;
+	long long int v, added;
+	size_t count;
+	int rc;
+
+	/* Version first, a commit in between only causes another load. */
+	if (version(db, sh, &v) < 0)
+		return -1;
+
+	/* Then the journal, its next entries may already be in the filter. */
+	stmt = statement(db, sh, STMT_IDS_LAST);
+
+	if (sqlite3_step(stmt) != SQLITE_ROW)
+		goto sqlite_err;
+
+	added = sqlite3_column_int64(stmt, 0);
+	release(stmt);
+	stmt = statement(db, sh, STMT_COUNT);
+
+	if (sqlite3_step(stmt) != SQLITE_ROW)
+		goto sqlite_err;
+
+	count = sqlite3_column_int64(stmt, 0);
+	release(stmt);
+
+	bloom_finish(&sh->bloom);
+	bloom_init(&sh->bloom, count * 2 < FILTER_MIN ? FILTER_MIN : count * 2);
+	sh->bloom.negatives = negatives;
+	sh->bloom.falsepos = falsepos;
+	stmt = statement(db, sh, STMT_IDS);
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		bloom_add(&sh->bloom, (const char *)sqlite3_column_text(stmt, 0));
+
+	if (rc != SQLITE_DONE)
+		goto sqlite_err;
+
+	release(stmt);
+	sh->version = v;
+	sh->added = added;
+
+	log_info("database: filter of %s filled with %zu pastes, %zu bytes, "
+	    "%.2f%% false positives expected, %.2f%% observed so far",
+	    sqlite3_db_filename(sh->handle, "main"), sh->bloom.count,
+	    bloom_size(&sh->bloom), bloom_rate(&sh->bloom) * 100,
+	    bloom_observed(&sh->bloom) * 100);
+
+	return 0;
+
+sqlite_err:
+	log_warn("database: error (filter): %s", sqlite3_errmsg(sh->reader));
+	release(stmt);
+
+	/* Without a filter every lookup goes to the database. */
+	bloom_finish(&sh->bloom);
+
+	return -1;
+}
+
+/*
+ * Add the identifiers other connections stored since the filter was filled,
+ * read from the journal of new identifiers. Pastes are never modified and a
+ * filter keeps removed ones, so only the new entries matter. The filter is
+ * filled again instead if the entries it needs were pruned or once it is too
+ * full.
+ */
+static int
+catch_up(struct database_sqlite *db, struct database_shard *sh)
+{
+	sqlite3_stmt *stmt;
+	const char *id;
+	long long int v, seq;
+	int rc;
+
+	if (version(db, sh, &v) < 0)
+		return -1;
+	if (v == sh->version)
+		return 0;
+
+	stmt = statement(db, sh, STMT_IDS_ADDED);
+	sqlite3_bind_int64(stmt, 1, sh->added);
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if ((seq = sqlite3_column_int64(stmt, 0)) != sh->added + 1) {
+			release(stmt);
+			return load(db, sh);
+		}
+
+		/* Our own pastes are already there. */
+		id = (const char *)sqlite3_column_text(stmt, 1);
+
+		if (!bloom_has(&sh->bloom, id))
+			bloom_add(&sh->bloom, id);
+
+		sh->added = seq;
+	}
+
+	if (rc != SQLITE_DONE) {
+		log_warn("database: error (filter): %s", sqlite3_errmsg(sh->reader));
+		release(stmt);
+		return -1;
+	}
+
+	release(stmt);
+
+	if (sh->bloom.count > sh->bloom.capacity)
+		return load(db, sh);
+
+	sh->version = v;
+
+	return 0;
+}
+
+/*
+ * Tell if the identifier is certainly not stored, without reading the paste
+ * table. Our own pastes are added as they are stored, those of other
+ * connections once they have committed.
+ */
+static int
+absent(struct database_sqlite *db, struct database_shard *sh, const char *id)
+{
+	if (!sh->bloom.bits || bloom_has(&sh->bloom, id))
+		return 0;
+	if (catch_up(db, sh) < 0 || !sh->bloom.bits || bloom_has(&sh->bloom, id))
+		return 0;
+
+	sh->bloom.negatives++;
+
+	return 1;
+}
+
+/*
+ * Pastes are spread over the shards by a FNV-1a hash of their identifier, so
+ * the shard count must not change once pastes are stored.
+ */
+static struct database_shard *
+shard(struct database_sqlite *db, const char *id)
+{
+	uint32_t hash = 2166136261U;
+
+	for (; *id; ++id)
+		hash = (hash ^ (unsigned char)*id) * 16777619U;
+
+	return &db->shards[hash % db->shardsz];
+}
+
+/*
+ * Group commit: commits only append to the WAL without waiting for the disk
+ * and the WAL file is synced once for all of them by database_sync, which
+ * also covers the commits other processes appended meanwhile.
+ *
+ * This needs a WAL profile with full synchronization, other journal modes
+ * keep syncing every commit and with normal synchronization commits are
+ * not synced anyway.
+ */
+static void
+group(struct database_shard *sh, const struct profile *prof, const char *path)
+{
+	char wal[PATH_MAX];
+
+	if (strcmp(prof->journal, "WAL") != 0 || strcmp(prof->synchronous, "FULL") != 0) {
+		log_warn("database: group commit needs a WAL profile with full synchronization, "
+		    "ignored for %s", path);
+		return;
+	}
+
+	snprintf(wal, sizeof (wal), "%s-wal", sqlite3_db_filename(sh->handle, "main"));
+
+	if (sqlite3_exec(sh->handle, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL) != SQLITE_OK ||
+	    (sh->wal = open(wal, O_RDWR)) < 0) {
+		log_warn("database: unable to enable group commit for %s", path);
+		return;
+	}
+
+	log_info("database: group commit enabled for %s", path);
+}
+
+static int
+functions(sqlite3 *handle)
+{
+	if (sqlite3_create_function_v2(handle, "body_text", 2,
+	    SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS,
+	    NULL, body_text, NULL, NULL, NULL) != SQLITE_OK ||
+	    sqlite3_create_function_v2(handle, "sha256", 1,
+	    SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS,
+	    NULL, sha256, NULL, NULL, NULL) != SQLITE_OK) {
+		log_warn("database: unable to register functions: %s", sqlite3_errmsg(handle));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Pages are served by a read-only connection so that they never queue behind
+ * the write transaction of a new paste or of the cleanup, it is opened once
+ * the writer has created the schema. A process serves one request at a time
+ * so one reader per shard is enough.
+ */
+static int
+open_reader(struct database_shard *sh, const char *path, const struct profile *prof)
+{
+	if (sqlite3_open_v2(path, (sqlite3 **)&sh->reader, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+		log_warn("database: unable to open %s for reading: %s", path, sqlite3_errmsg(sh->reader));
+		return -1;
+	}
+
+	sqlite3_busy_timeout(sh->reader, 30000);
+
+	if (tune_reader(sh, prof) < 0) {
+		log_warn("database: unable to tune reader of %s: %s", path, sqlite3_errmsg(sh->reader));
+		return -1;
+	}
+
+	return functions(sh->reader);
+}
+
+static int
+open_shard(const struct database_sqlite *db,
+           struct database_shard *sh,
+           const char *path,
+           const struct profile *prof,
+           int create)
+{
+	const int flags = SQLITE_OPEN_READWRITE | (create ? SQLITE_OPEN_CREATE : 0);
+
+	sh->wal = -1;
+
+	if (sqlite3_open_v2(path, (sqlite3 **)&sh->handle, flags, NULL) != SQLITE_OK) {
+		log_warn("database: unable to open %s: %s", path, sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+
+	/* Wait for 30 seconds to lock the database. */
+	sqlite3_busy_timeout(sh->handle, 30000);
+
+	if (tune(sh, prof) < 0) {
+		log_warn("database: unable to tune %s: %s", path, sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+	if (functions(sh->handle) < 0)
+		return -1;
+	if (sqlite3_exec(sh->handle, CHAR(sql_init), NULL, NULL, NULL) != SQLITE_OK) {
+		log_warn("database: unable to initialize %s: %s", path, sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+	if (upgrade(sh) < 0) {
+		log_warn("database: unable to upgrade %s", path);
+		return -1;
+	}
+	if (open_reader(sh, path, prof) < 0)
+		return -1;
+	if (prepare(sh) < 0) {
+		log_warn("database: unable to prepare statements: %s", sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+	if (!db->maintenance && (config.commitwindow || config.commitrows))
+		group(sh, prof, path);
+
+	return 0;
+}
+
+static void
+close_shard(struct database_shard *sh)
+{
+	if (sh->wal >= 0)
+		close(sh->wal);
+
+	bloom_finish(&sh->bloom);
+
+	if (sh->stmts) {
+		for (size_t i = 0; i < STMT_LAST; ++i)
+			sqlite3_finalize(sh->stmts[i]);
+
+		free(sh->stmts);
+	}
+
+	sqlite3_close(sh->reader);
+	sqlite3_close(sh->handle);
+	memset(sh, 0, sizeof (*sh));
+}
+
+/*
+ * Time buckets: with a bucket width, a new paste is stored in the file of the
+ * period its expiration falls in, named after the end of that period, and
+ * the shard of its identifier records which one. Once the period is over
+ * every paste of the file has expired and the file is removed as a whole
+ * instead of deleting its pastes one by one. The width may change at any
+ * time since each bucket keeps its own end.
+ *
+ * Buckets are opened when first needed, and only created by insertions.
+ */
+static int
+bucket_path(const struct database_sqlite *db, long long int expires, char *path, size_t pathsz)
+{
+	if ((size_t)snprintf(path, pathsz, "%s.bucket-%lld", db->path, expires) >= pathsz) {
+		log_warn("database: bucket path of %s too long", db->path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct database_shard *
+bucket(struct database_sqlite *db, long long int expires, int create)
+{
+	struct database_bucket b = { .expires = expires };
+	struct database_shard *sh;
+	char file[PATH_MAX];
+
+	for (size_t i = 0; i < db->bucketsz; ++i)
+		if (db->buckets[i].expires == expires)
+			return &db->buckets[i].shard;
+
+	if (bucket_path(db, expires, file, sizeof (file)) < 0)
+		return NULL;
+	if (open_shard(db, &b.shard, file, profile(config.databaseprofile), create) < 0) {
+		close_shard(&b.shard);
+		return NULL;
+	}
+
+	log_debug("database: opened bucket %s", file);
+
+	/* The array may move, database_sync must not go through it meanwhile. */
+	pthread_mutex_lock(&db->mutex);
+
+	if (!(db->buckets = realloc(db->buckets, (db->bucketsz + 1) * sizeof (*db->buckets))))
+		die("abort: %s", strerror(errno));
+
+	db->buckets[db->bucketsz] = b;
+	sh = &db->buckets[db->bucketsz++].shard;
+	pthread_mutex_unlock(&db->mutex);
+
+	return sh;
+}
+
+/*
+ * Close the buckets whose pastes have all expired, whether their file is
+ * removed yet or not.
+ */
+static void
+expire(struct database_sqlite *db, time_t now)
+{
+	pthread_mutex_lock(&db->mutex);
+
+	for (size_t i = 0; i < db->bucketsz; ) {
+		if (db->buckets[i].expires > now) {
+			++i;
+			continue;
+		}
+
+		close_shard(&db->buckets[i].shard);
+		db->buckets[i] = db->buckets[--db->bucketsz];
+	}
+
+	pthread_mutex_unlock(&db->mutex);
+}
+
+/*
+ * Open the buckets created by other processes before going through all of
+ * them. A failure only leaves their pastes out of the listing.
+ */
+static void
+discover(struct database_sqlite *db)
+{
+	struct database_shard *sh;
+	sqlite3_stmt *stmt;
+	const time_t now = time(NULL);
+	int rc;
+
+	expire(db, now);
+
+	for (size_t s = 0; s < db->shardsz; ++s) {
+		sh = &db->shards[s];
+		stmt = statement(db, sh, STMT_BUCKETS);
+		sqlite3_bind_int64(stmt, 1, now);
+
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+			bucket(db, sqlite3_column_int64(stmt, 0), 0);
+
+		if (rc != SQLITE_DONE)
+			log_warn("database: error (buckets): %s", sqlite3_errmsg(sh->reader));
+
+		release(stmt);
+	}
+}
+
+/*
+ * Tell if some shard records a bucket not expired yet, databases which never
+ * used buckets then skip looking for them. Processes sharing a database are
+ * expected to use the same bucket width.
+ */
+static int
+partitioned(struct database_sqlite *db)
+{
+	sqlite3_stmt *stmt;
+	int rc = SQLITE_DONE;
+
+	for (size_t s = 0; s < db->shardsz && rc == SQLITE_DONE; ++s) {
+		stmt = statement(db, &db->shards[s], STMT_BUCKETS);
+		sqlite3_bind_int64(stmt, 1, time(NULL));
+		rc = sqlite3_step(stmt);
+		release(stmt);
+	}
+
+	return rc != SQLITE_DONE;
+}
+
+/*
+ * Files a listing goes through: the shards then the buckets.
+ */
+static size_t
+sources(const struct database_sqlite *db)
+{
+	return db->shardsz + db->bucketsz;
+}
+
+static struct database_shard *
+source(struct database_sqlite *db, size_t i)
+{
+	return i < db->shardsz ? &db->shards[i] : &db->buckets[i - db->shardsz].shard;
+}
+
+static void
+engine_finish(struct database *);
+
+static int
+engine_open(struct database *base, const char *path)
+{
+	struct database_sqlite *db;
+	const struct profile *prof;
+	char file[PATH_MAX];
+
+	log_info("database: opening %s (profile %s, %zu shards)", path,
+	    config.databaseprofile, config.databaseshards);
+
+	if (!(prof = profile(config.databaseprofile))) {
+		log_warn("database: unknown profile %s", config.databaseprofile);
+		return -1;
+	}
+	if (config.databaseshards < 1) {
+		log_warn("database: invalid number of shards");
+		return -1;
+	}
+
+	base->data = db = ecalloc(1, sizeof (*db));
+	pthread_mutex_init(&db->mutex, NULL);
+	db->maintenance = base->maintenance;
+	db->shardsz = config.databaseshards;
+	db->shards = ecalloc(db->shardsz, sizeof (*db->shards));
+	snprintf(db->path, sizeof (db->path), "%s", path);
+
+	/* The first shard is the database path itself, then path.1, path.2... */
+	for (size_t i = 0; i < db->shardsz; ++i) {
+		if (i == 0)
+			snprintf(file, sizeof (file), "%s", path);
+		else
+			snprintf(file, sizeof (file), "%s.%zu", path, i);
+
+		if (open_shard(db, &db->shards[i], file, prof, 1) < 0)
+			goto err;
+		if (!db->maintenance)
+			load(db, &db->shards[i]);
+	}
+
+	db->partitioned = config.databasebucket || partitioned(db);
+
+	/* Every file uses the same profile, buckets included. */
+	base->grouped = db->shards[0].wal >= 0;
+
+	return 0;
+
+err:
+	engine_finish(base);
+
+	return -1;
+}
+
+/*
+ * Bind the (date, id) key listings start after, without one everything is
+ * lower than the largest date.
+ */
+static int
+bind_after(sqlite3_stmt *stmt, int col, const struct paste *after)
+{
+	if (sqlite3_bind_int64(stmt, col, after ? after->timestamp : INT64_MAX) != SQLITE_OK)
+		return -1;
+	if (sqlite3_bind_text(stmt, col + 1, after ? after->id : "", -1, SQLITE_STATIC) != SQLITE_OK)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Listing read row by row: every shard and bucket runs its own statement
+ * which stays on its current row, the cursor row is the first of them in
+ * listing order and its file is stepped at the next call. Rank is only
+ * compared for full text searches where lower is better.
+ */
+struct listing {
+	struct database_sqlite *db;
+	sqlite3_stmt **stmts;           /* One per file, NULL once done. */
+	size_t stmtsz;                  /* Number of files. */
+	size_t current;                 /* File of the cursor row. */
+	int ranked;                     /* Ordered by relevance first. */
+	char *match;                    /* Parameters bound to the statements. */
+	char *trigrams;
+	char *title;
+	char *author;
+};
+
+static struct listing *
+listing(struct database_sqlite *db, struct database_cursor *cursor)
+{
+	struct listing *ls;
+
+	if (db->partitioned)
+		discover(db);
+
+	cursor->data = ls = ecalloc(1, sizeof (*ls));
+	ls->db = db;
+	ls->stmtsz = sources(db);
+	ls->stmts = ecalloc(ls->stmtsz, sizeof (*ls->stmts));
+	ls->current = ls->stmtsz;
+
+	return ls;
+}
+
+static void
+engine_cursor_finish(struct database_cursor *cursor)
+{
+	struct listing *ls = cursor->data;
+
+	if (!ls)
+		return;
+
+	for (size_t s = 0; s < ls->stmtsz; ++s)
+		if (ls->stmts[s])
+			release(ls->stmts[s]);
+
+	free(ls->stmts);
+	free(ls->match);
+	free(ls->trigrams);
+	free(ls->title);
+	free(ls->author);
+	free(ls);
+	cursor->data = NULL;
+}
+
+/*
+ * Tell if the current row of s1 comes before the one of s2.
+ */
+static int
+ahead(sqlite3_stmt *s1, sqlite3_stmt *s2, int ranked)
+{
+	double r1, r2;
+	sqlite3_int64 d1, d2;
+
+	if (ranked && (r1 = sqlite3_column_double(s1, 8)) != (r2 = sqlite3_column_double(s2, 8)))
+		return r1 < r2;
+	if ((d1 = sqlite3_column_int64(s1, 4)) != (d2 = sqlite3_column_int64(s2, 4)))
+		return d1 > d2;
+
+	return strcmp((const char *)sqlite3_column_text(s1, 0),
+	    (const char *)sqlite3_column_text(s2, 0)) > 0;
+}
+
+static int
+advance(struct listing *ls, size_t s)
+{
+	int rc;
+
+	if ((rc = sqlite3_step(ls->stmts[s])) == SQLITE_ROW)
+		return 0;
+	if (rc != SQLITE_DONE)
+		log_warn("database: error (listing): %s", sqlite3_errmsg(source(ls->db, s)->reader));
+
+	release(ls->stmts[s]);
+	ls->stmts[s] = NULL;
+
+	return rc == SQLITE_DONE ? 0 : -1;
+}
+
+static void
+column(sqlite3_stmt *stmt, int col, struct database_text *text)
+{
+	/* Bytes after text, as the conversion may change them. */
+	text->data = (const char *)sqlite3_column_text(stmt, col);
+	text->len = sqlite3_column_bytes(stmt, col);
+}
+
+/*
+ * Step every file to its first row once bound, so that errors are known
+ * before the caller starts using rows.
+ */
+static int
+start(struct database_cursor *cursor)
+{
+	struct listing *ls = cursor->data;
+
+	for (size_t s = 0; s < ls->stmtsz; ++s) {
+		if (advance(ls, s) < 0) {
+			engine_cursor_finish(cursor);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+engine_cursor_next(struct database_cursor *cursor)
+{
+	struct listing *ls = cursor->data;
+	struct database_row *row = &cursor->row;
+	sqlite3_stmt *stmt;
+	size_t best = ls->stmtsz;
+
+	if (ls->current < ls->stmtsz && advance(ls, ls->current) < 0)
+		return -1;
+
+	for (size_t s = 0; s < ls->stmtsz; ++s)
+		if (ls->stmts[s] && (best == ls->stmtsz ||
+		    ahead(ls->stmts[s], ls->stmts[best], ls->ranked)))
+			best = s;
+
+	if ((ls->current = best) == ls->stmtsz)
+		return 0;
+
+	stmt = ls->stmts[best];
+	memset(row, 0, sizeof (*row));
+	column(stmt, 0, &row->id);
+	column(stmt, 1, &row->title);
+	column(stmt, 2, &row->author);
+	column(stmt, 3, &row->language);
+	row->timestamp = sqlite3_column_int64(stmt, 4);
+	row->visible = sqlite3_column_int(stmt, 5);
+	row->duration = sqlite3_column_int64(stmt, 6);
+
+	if (ls->match)
+		column(stmt, 7, &row->snippet);
+
+	return 1;
+}
+
+static int
+engine_cursor_recents(struct database *base,
+                      struct database_cursor *cursor,
+                      const struct paste *after)
+{
+	struct database_sqlite *db = base->data;
+	struct listing *ls = listing(db, cursor);
+	sqlite3_stmt *stmt;
+
+	log_debug("database: accessing most recents");
+
+	for (size_t s = 0; s < ls->stmtsz; ++s) {
+		ls->stmts[s] = stmt = statement(db, source(db, s), STMT_RECENTS);
+
+		if (bind_after(stmt, 1, after) < 0 ||
+		    sqlite3_bind_int64(stmt, 3, cursor->max) != SQLITE_OK) {
+			log_warn("database: error (recents): %s", sqlite3_errmsg(source(db, s)->reader));
+			engine_cursor_finish(cursor);
+			return -1;
+		}
+	}
+
+	return start(cursor);
+}
+
+/*
+ * Changes whenever another connection commits into any of the shards, which
+ * includes pastes stored in buckets as they are recorded in their shard.
+ */
+static long long int
+engine_version(struct database *base)
+{
+	struct database_sqlite *db = base->data;
+	long long int v, sum = 0;
+
+	for (size_t s = 0; s < db->shardsz; ++s) {
+		if (version(db, &db->shards[s], &v) < 0)
+			return -1;
+
+		sum += v;
+	}
+
+	return sum;
+}
+
+/*
+ * Fill the paste code from the current row, leaving it as stored if its
+ * encoding is the accepted one and decoding it otherwise.
+ */
+static int
+body(sqlite3_stmt *stmt, struct paste *paste, enum paste_encoding accept)
+{
+	const void *data = sqlite3_column_blob(stmt, 7);
+	const size_t len = sqlite3_column_bytes(stmt, 7);
+
+	paste->encoding = sqlite3_column_int(stmt, 8);
+
+	if (paste->encoding == PASTE_ENCODING_IDENTITY || paste->encoding == accept) {
+		paste->code = ecalloc(1, len + 1);
+		paste->codesz = len;
+
+		if (len)
+			memcpy(paste->code, data, len);
+
+		return 0;
+	}
+
+	paste->encoding = PASTE_ENCODING_IDENTITY;
+
+	if (!(paste->code = gzip_decompress(data, len, &paste->codesz)))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Find the file of a paste: the bucket recorded in its shard if any,
+ * otherwise the shard itself. Returns NULL if it is certainly not stored or
+ * its bucket has expired.
+ */
+static struct database_shard *
+locate(struct database_sqlite *db, const char *id)
+{
+	struct database_shard *sh = shard(db, id);
+	sqlite3_stmt *stmt;
+	long long int expires = 0;
+	int rc;
+
+	if (absent(db, sh, id))
+		return NULL;
+	if (!db->partitioned)
+		return sh;
+
+	stmt = statement(db, sh, STMT_BUCKET_FIND);
+	sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC);
+
+	if ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		expires = sqlite3_column_int64(stmt, 0);
+	else if (rc != SQLITE_DONE)
+		log_warn("database: error (locate): %s", sqlite3_errmsg(sh->reader));
+
+	release(stmt);
+
+	if (rc == SQLITE_DONE)
+		return sh;
+	if (rc != SQLITE_ROW || expires <= time(NULL))
+		return NULL;
+
+	return bucket(db, expires, 0);
+}
+
+static int
+get(struct database_sqlite *db, struct paste *paste, const char *id, enum paste_encoding accept)
+{
+	struct database_shard *sh;
+	sqlite3_stmt *stmt;
+	int found = -1;
+
+	paste_reset(paste);
+	log_debug("database: accessing paste with id: %s", id);
+
+	if (!(sh = locate(db, id)))
+		return -1;
+
+	stmt = statement(db, sh, STMT_GET);
+
+	if (sqlite3_bind_text(stmt, 1, id, -1, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	switch (sqlite3_step(stmt)) {
+	case SQLITE_ROW:
+		convert(stmt, paste);
+
+		if (body(stmt, paste, accept) < 0) {
+			log_warn("database: invalid body for paste %s", id);
+			paste_finish(paste);
+			break;
+		}
+
+		found = 0;
+		break;
+	case SQLITE_MISUSE:
+	case SQLITE_ERROR:
+		goto sqlite_err;
+	default:
+		sh->bloom.falsepos += sh->bloom.bits != NULL;
+		break;
+	}
+
+	release(stmt);
+
+	return found;
+
+sqlite_err:
+	log_warn("database: error (get): %s", sqlite3_errmsg(sh->reader));
+	release(stmt);
+
+	return -1;
+}
+
+static int
+engine_get(struct database *base, struct paste *paste, const char *id, enum paste_encoding accept)
+{
+	return get(base->data, paste, id, accept);
+}
+
+static void
+engine_stream_close(struct database_stream *);
+
+static int
+engine_stream_open(struct database *base,
+                   struct database_stream *stream,
+                   struct paste *paste,
+                   const char *id,
+                   enum paste_encoding accept)
+{
+	struct database_sqlite *db = base->data;
+	struct database_shard *sh;
+	sqlite3_stmt *stmt = NULL;
+	sqlite3_int64 rowid;
+	unsigned char trailer[4];
+	int rc;
+
+	memset(stream, 0, sizeof (*stream));
+	paste_reset(paste);
+	log_debug("database: streaming paste with id: %s", id);
+
+	if (!(sh = locate(db, id)))
+		return -1;
+
+	/* Keep the same snapshot from the lookup until the last chunk. */
+	if (sqlite3_exec(sh->reader, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	stmt = statement(db, sh, STMT_STREAM);
+
+	if (sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC) != SQLITE_OK)
+		goto sqlite_err;
+	if ((rc = sqlite3_step(stmt)) != SQLITE_ROW) {
+		if (rc != SQLITE_DONE)
+			goto sqlite_err;
+
+		sh->bloom.falsepos += sh->bloom.bits != NULL;
+		release(stmt);
+		sqlite3_exec(sh->reader, "COMMIT", NULL, NULL, NULL);
+
+		return -1;
+	}
+
+	convert(stmt, paste);
+	rowid = sqlite3_column_int64(stmt, 7);
+	paste->encoding = sqlite3_column_int(stmt, 8);
+	release(stmt);
+	stmt = NULL;
+
+	if (sqlite3_blob_open(sh->reader, "main", "body", "code", rowid, 0,
+	    (sqlite3_blob **)&stream->blob) != SQLITE_OK)
+		goto sqlite_err;
+
+	stream->handle = sh->reader;
+	stream->size = sqlite3_blob_bytes(stream->blob);
+	paste->codesz = stream->size;
+
+	/* Decoded on the fly, the plain size is in the gzip trailer. */
+	if (paste->encoding != PASTE_ENCODING_IDENTITY && paste->encoding != accept) {
+		if (stream->size < 18 ||
+		    sqlite3_blob_read(stream->blob, trailer, 4, stream->size - 4) != SQLITE_OK ||
+		    !(stream->inflater = gzip_stream_open())) {
+			log_warn("database: invalid body for paste %s", id);
+			engine_stream_close(stream);
+			paste_finish(paste);
+
+			return -1;
+		}
+
+		paste->encoding = PASTE_ENCODING_IDENTITY;
+		paste->codesz = gzip_stream_size(trailer);
+	}
+
+	return 0;
+
+sqlite_err:
+	log_warn("database: error (stream): %s", sqlite3_errmsg(sh->reader));
+
+	if (stmt)
+		release(stmt);
+
+	sqlite3_exec(sh->reader, "ROLLBACK", NULL, NULL, NULL);
+	paste_finish(paste);
+
+	return -1;
+}
+
+/*
+ * Fill the input buffer with the next chunk of the blob if it is empty.
+ */
+static int
+refill(struct database_stream *stream)
+{
+	size_t n;
+
+	if (stream->inlen || stream->offset == stream->size)
+		return 0;
+
+	n = stream->size - stream->offset;
+	n = n < sizeof (stream->in) ? n : sizeof (stream->in);
+
+	if (sqlite3_blob_read(stream->blob, stream->in, n, stream->offset) != SQLITE_OK)
+		return -1;
+
+	stream->next = stream->in;
+	stream->inlen = n;
+	stream->offset += n;
+
+	return 0;
+}
+
+static long long int
+engine_stream_read(struct database_stream *stream, void *buf, size_t bufsz)
+{
+	size_t n;
+	int rc;
+
+	if (!stream->inflater) {
+		n = stream->size - stream->offset;
+		n = n < bufsz ? n : bufsz;
+
+		if (n && sqlite3_blob_read(stream->blob, buf, n, stream->offset) != SQLITE_OK)
+			goto sqlite_err;
+
+		stream->offset += n;
+
+		return n;
+	}
+
+	/* Compressed input may need several chunks to produce some output. */
+	do {
+		if (stream->end)
+			return 0;
+		if (refill(stream) < 0)
+			goto sqlite_err;
+		if (!stream->inlen)
+			return -1;
+
+		n = bufsz;
+
+		if ((rc = gzip_stream_inflate(stream->inflater, &stream->next,
+		    &stream->inlen, buf, &n)) < 0)
+			return -1;
+
+		stream->end = rc;
+	} while (n == 0);
+
+	return n;
+
+sqlite_err:
+	log_warn("database: error (stream): %s", sqlite3_errmsg(stream->handle));
+
+	return -1;
+}
+
+static void
+engine_stream_close(struct database_stream *stream)
+{
+	gzip_stream_close(stream->inflater);
+
+	if (stream->blob) {
+		sqlite3_blob_close(stream->blob);
+		sqlite3_exec(stream->handle, "COMMIT", NULL, NULL, NULL);
+	}
+
+	memset(stream, 0, sizeof (*stream));
+}
+
+/*
+ * Compress code by chunks and write them into the blob, or only count them
+ * if blob is NULL in which case it stops as soon as the output is not smaller
+ * than the input. Returns the compressed size or -1 on errors.
+ */
+static long long int
+deflated(const char *code, size_t len, sqlite3_blob *blob)
+{
+	unsigned char chunk[DATABASE_STREAM_CHUNK];
+	struct gzip *gz;
+	const void *in = code;
+	size_t inlen = len, n;
+	long long int total = 0;
+	int rc;
+
+	if (!(gz = gzip_stream_deflater()))
+		return -1;
+
+	do {
+		n = sizeof (chunk);
+
+		if ((rc = gzip_stream_deflate(gz, &in, &inlen, chunk, &n)) < 0)
+			break;
+		if (blob && sqlite3_blob_write(blob, chunk, n, total) != SQLITE_OK) {
+			rc = -1;
+			break;
+		}
+
+		total += n;
+	} while (rc == 0 && (blob || total < (long long int)len));
+
+	gzip_stream_close(gz);
+
+	return rc < 0 ? -1 : total;
+}
+
+/*
+ * Reserve a new body of the final size and fill it by chunks straight from
+ * the code so that neither SQLite nor the compression copy it as a whole.
+ */
+static int
+store(struct database_sqlite *db, struct database_shard *sh, const char *code, size_t len, const char *hash)
+{
+	sqlite3_stmt *stmt;
+	sqlite3_blob *blob = NULL;
+	long long int packedsz = -1;
+	size_t n;
+	int rc = -1;
+
+	/* Only keep the compressed body if it is actually smaller. */
+	if (config.compression && len >= config.compression &&
+	    (packedsz = deflated(code, len, NULL)) >= (long long int)len)
+		packedsz = -1;
+
+	stmt = statement(db, sh, STMT_INSERT_BODY);
+	sqlite3_bind_text(stmt, 1, hash, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 2, packedsz < 0 ? (long long int)len : packedsz);
+	sqlite3_bind_int(stmt, 3, packedsz < 0 ? PASTE_ENCODING_IDENTITY : PASTE_ENCODING_GZIP);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto end;
+	if (sqlite3_blob_open(sh->handle, "main", "body", "code",
+	    sqlite3_last_insert_rowid(sh->handle), 1, &blob) != SQLITE_OK)
+		goto end;
+
+	if (packedsz >= 0) {
+		if (deflated(code, len, blob) != packedsz)
+			goto end;
+	} else {
+		for (size_t off = 0; off < len; off += n) {
+			n = len - off < DATABASE_STREAM_CHUNK ? len - off : DATABASE_STREAM_CHUNK;
+
+			if (sqlite3_blob_write(blob, code + off, n, off) != SQLITE_OK)
+				goto end;
+		}
+	}
+
+	rc = 0;
+
+end:
+	if (blob && sqlite3_blob_close(blob) != SQLITE_OK)
+		rc = -1;
+
+	release(stmt);
+
+	return rc;
+}
+
+/*
+ * Store the paste with its current identifier in the given shard or bucket.
+ * Return 0 on success, 1 if the identifier is already taken and -1 on
+ * errors.
+ */
+static int
+insert(struct database_sqlite *db,
+       struct database_shard *sh,
+       struct paste *paste,
+       const char *code,
+       size_t len,
+       const char *hash,
+       time_t date)
+{
+	sqlite3_stmt *stmt = NULL;
+	int shared;
+
+	if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+		log_warn("database: could not lock database: %s", sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+
+	/*
+	 * Forks and repeated pastes only take a reference on the existing
+	 * body, otherwise store it before the paste so the full text index
+	 * can read it from the insert trigger.
+	 */
+	stmt = statement(db, sh, STMT_SHARE_BODY);
+	sqlite3_bind_text(stmt, 1, hash, -1, SQLITE_STATIC);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto sqlite_err;
+
+	shared = sqlite3_changes(sh->handle);
+	release(stmt);
+	stmt = NULL;
+
+	if (!shared) {
+		if (store(db, sh, code, len, hash) < 0)
+			goto sqlite_err;
+	} else
+		log_debug("database: reusing body %s", hash);
+
+	stmt = statement(db, sh, STMT_INSERT);
+	sqlite3_bind_text(stmt, 1, paste->id, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, paste->title, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, paste->author, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 4, paste->language, -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 5, paste->visible);
+	sqlite3_bind_int64(stmt, 6, paste->duration);
+	sqlite3_bind_text(stmt, 7, hash, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 8, date);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
+		if (sqlite3_extended_errcode(sh->handle) != SQLITE_CONSTRAINT_PRIMARYKEY)
+			goto sqlite_err;
+
+		release(stmt);
+		sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+		return 1;
+	}
+
+	release(stmt);
+
+	if (sqlite3_exec(sh->handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	return 0;
+
+sqlite_err:
+	log_warn("database: error (insert): %s", sqlite3_errmsg(sh->handle));
+
+	if (stmt)
+		release(stmt);
+
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+	return -1;
+}
+
+/*
+ * Record the bucket of the paste in the shard of its identifier, then store
+ * the paste in the bucket while the record is not committed yet so that
+ * both are rolled back on errors. Returns like insert.
+ *
+ * The bucket is committed first, a crash right after only leaves a paste
+ * which is listed but not found until its bucket is removed.
+ */
+static int
+insert_bucket(struct database_sqlite *db,
+              struct paste *paste,
+              const char *code,
+              size_t len,
+              const char *hash,
+              time_t date)
+{
+	struct database_shard *sh = shard(db, paste->id), *b;
+	sqlite3_stmt *stmt = NULL;
+	long long int expires;
+	int rc;
+
+	/* End of the period the expiration falls in. */
+	expires = (date + paste->duration) / config.databasebucket * config.databasebucket +
+	    config.databasebucket;
+
+	if (!(b = bucket(db, expires, 1)))
+		return -1;
+	if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+		log_warn("database: could not lock database: %s", sqlite3_errmsg(sh->handle));
+		return -1;
+	}
+
+	stmt = statement(db, sh, STMT_BUCKET_CREATE);
+	sqlite3_bind_int64(stmt, 1, expires);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto sqlite_err;
+
+	release(stmt);
+	stmt = statement(db, sh, STMT_BUCKET_INSERT);
+	sqlite3_bind_text(stmt, 1, paste->id, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 2, expires);
+
+	if ((rc = sqlite3_step(stmt)) != SQLITE_DONE &&
+	    sqlite3_extended_errcode(sh->handle) != SQLITE_CONSTRAINT_PRIMARYKEY)
+		goto sqlite_err;
+
+	/* Also taken if stored in the shard before buckets were used. */
+	if (rc != SQLITE_DONE || !sqlite3_changes(sh->handle)) {
+		release(stmt);
+		sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+		return 1;
+	}
+
+	release(stmt);
+	stmt = NULL;
+
+	if ((rc = insert(db, b, paste, code, len, hash, date)) != 0) {
+		sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+		return rc;
+	}
+	if (sqlite3_exec(sh->handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	return 0;
+
+sqlite_err:
+	log_warn("database: error (insert): %s", sqlite3_errmsg(sh->handle));
+
+	if (stmt)
+		release(stmt);
+
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+	return -1;
+}
+
+static int
+engine_insert(struct database *base, struct paste *paste, const char *code, size_t len)
+{
+	struct database_sqlite *db = base->data;
+	struct database_shard *sh;
+	char hash[SHA256_HEX_LENGTH];
+	const time_t date = time(NULL);
+	int tries = 0, rc;
+
+	sha256_hex(code, len, hash);
+
+	/*
+	 * If the identifier is already taken we just pick another one, which
+	 * may belong to another shard.
+	 */
+	do {
+		paste_create_id(paste);
+
+		if (config.databasebucket)
+			rc = insert_bucket(db, paste, code, len, hash, date);
+		else
+			rc = insert(db, shard(db, paste->id), paste, code, len, hash, date);
+	} while (rc == 1 && ++tries < 8);
+
+	if (rc == 1)
+		log_warn("database: error (insert): no free identifier found");
+	/* The identifier is released by database_insert_code. */
+	if (rc != 0)
+		return -1;
+
+	/*
+	 * Reloaded larger on the next miss once it is too full, which only
+	 * happens each time the number of pastes doubles.
+	 */
+	sh = shard(db, paste->id);
+
+	if (sh->bloom.bits) {
+		bloom_add(&sh->bloom, paste->id);
+
+		if (sh->bloom.count > sh->bloom.capacity)
+			sh->version = -1;
+	}
+
+	return 0;
+}
+
+static int
+engine_cursor_search(struct database *base,
+                     struct database_cursor *cursor,
+                     const char *title,
+                     const char *author,
+                     const char *language,
+                     const char *query,
+                     const struct paste *after)
+{
+	struct database_sqlite *db = base->data;
+	struct listing *ls = listing(db, cursor);
+	struct database_shard *sh;
+	sqlite3_stmt *stmt;
+	int col;
+
+	/* Select everything if not specified. */
+	ls->title  = contains(title    ? title    : "");
+	ls->author = contains(author   ? author   : "");
+	language   = language ? language : "%";
+
+	if (query)
+		ls->match = fulltext(query);
+	if (!ls->match)
+		ls->trigrams = trigram(title, author);
+
+	ls->ranked = ls->match != NULL;
+
+	for (size_t s = 0; s < ls->stmtsz; ++s) {
+		sh = source(db, s);
+		col = 1;
+
+		if (ls->match) {
+			ls->stmts[s] = stmt = statement(db, sh, STMT_FULLTEXT);
+
+			if (sqlite3_bind_text(stmt, col++, ls->match, -1, SQLITE_STATIC) != SQLITE_OK)
+				goto sqlite_err;
+		} else if (ls->trigrams) {
+			ls->stmts[s] = stmt = statement(db, sh, STMT_SUBSTRING);
+
+			if (sqlite3_bind_text(stmt, col++, ls->trigrams, -1, SQLITE_STATIC) != SQLITE_OK)
+				goto sqlite_err;
+		} else
+			ls->stmts[s] = stmt = statement(db, sh, STMT_SEARCH);
+
+		if (sqlite3_bind_text(stmt, col++, ls->title, -1, SQLITE_STATIC) != SQLITE_OK)
+			goto sqlite_err;
+		if (sqlite3_bind_text(stmt, col++, ls->author, -1, SQLITE_STATIC) != SQLITE_OK)
+			goto sqlite_err;
+		if (sqlite3_bind_text(stmt, col++, language, -1, SQLITE_TRANSIENT) != SQLITE_OK)
+			goto sqlite_err;
+
+		/* Full text results are ranked by relevance rather than paginated. */
+		if (!ls->match) {
+			if (bind_after(stmt, col, after) < 0)
+				goto sqlite_err;
+
+			col += 2;
+		}
+
+		if (sqlite3_bind_int64(stmt, col++, cursor->max) != SQLITE_OK)
+			goto sqlite_err;
+	}
+
+	return start(cursor);
+
+sqlite_err:
+	log_warn("database: error (search): %s", sqlite3_errmsg(sh->reader));
+	engine_cursor_finish(cursor);
+
+	return -1;
+}
+
+/*
+ * Monotonic clock in milliseconds, to time clear batches.
+ */
+static long long int
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Remove expired pastes in a single transaction until either the row or time
+ * budget is exhausted. Return the number of rows deleted or -1 on error and
+ * set *done if there is nothing left to delete.
+ */
+static int
+clear(struct database_sqlite *db, struct database_shard *sh, long long int start, int *done)
+{
+	sqlite3_stmt *stmt = NULL;
+	size_t chunk;
+	int total = 0, n;
+
+	if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	do {
+		chunk = CLEAR_CHUNK;
+
+		if (config.clearrows && config.clearrows - total < chunk)
+			chunk = config.clearrows - total;
+
+		stmt = statement(db, sh, STMT_CLEAR);
+		sqlite3_bind_int64(stmt, 1, chunk);
+
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+			goto sqlite_err;
+
+		n = sqlite3_changes(sh->handle);
+		total += n;
+		release(stmt);
+
+		*done = (size_t)n < chunk;
+	} while (!*done &&
+	    (!config.clearrows || (size_t)total < config.clearrows) &&
+	    (!config.cleartime || now() - start < config.cleartime));
+
+	if (sqlite3_exec(sh->handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	return total;
+
+sqlite_err:
+	log_warn("database: error (clear): %s", sqlite3_errmsg(sh->handle));
+
+	if (stmt)
+		release(stmt);
+
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+	return -1;
+}
+
+/*
+ * Forget the journal entries of new identifiers that every process running
+ * has already read, removed identifiers stay in the filters until they are
+ * filled again.
+ */
+static void
+prune(struct database_sqlite *db, struct database_shard *sh)
+{
+	sqlite3_stmt *stmt = statement(db, sh, STMT_IDS_PRUNE);
+
+	sqlite3_bind_int64(stmt, 1, time(NULL) - FILTER_JOURNAL);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		log_warn("database: error (prune): %s", sqlite3_errmsg(sh->handle));
+
+	release(stmt);
+}
+
+/*
+ * Forget the expired buckets recorded in the shard, with the identifiers of
+ * their pastes, then remove their files. Processes still using one of them
+ * keep reading their open file until they notice it has expired. Return the
+ * number of buckets removed or -1 on error.
+ */
+static int
+drop(struct database_sqlite *db, struct database_shard *sh, time_t date)
+{
+	sqlite3_stmt *stmt = NULL;
+	long long int *expired = NULL;
+	size_t expiredsz = 0;
+	char file[PATH_MAX];
+	int rc;
+
+	if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	stmt = statement(db, sh, STMT_BUCKET_DROP);
+	sqlite3_bind_int64(stmt, 1, date);
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (!(expired = realloc(expired, (expiredsz + 1) * sizeof (*expired))))
+			die("abort: %s", strerror(errno));
+
+		expired[expiredsz++] = sqlite3_column_int64(stmt, 0);
+	}
+
+	if (rc != SQLITE_DONE)
+		goto sqlite_err;
+
+	release(stmt);
+	stmt = NULL;
+
+	if (sqlite3_exec(sh->handle, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+		goto sqlite_err;
+
+	expire(db, date);
+
+	for (size_t i = 0; i < expiredsz; ++i) {
+		if (bucket_path(db, expired[i], file, sizeof (file)) < 0)
+			continue;
+
+		log_debug("database: removing bucket %s", file);
+
+		if (remove(file) < 0 && errno != ENOENT)
+			log_warn("database: unable to remove %s: %s", file, strerror(errno));
+
+		remove(bprintf("%s-wal", file));
+		remove(bprintf("%s-shm", file));
+		remove(bprintf("%s-journal", file));
+	}
+
+	free(expired);
+
+	return expiredsz;
+
+sqlite_err:
+	log_warn("database: error (drop): %s", sqlite3_errmsg(sh->handle));
+
+	if (stmt)
+		release(stmt);
+
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+	free(expired);
+
+	return -1;
+}
+
+static int
+engine_clear(struct database *base)
+{
+	struct database_sqlite *db = base->data;
+	const struct timespec yield = { .tv_nsec = CLEAR_YIELD * 1000000L };
+	long long int start, elapsed = 0;
+	int done, batches = 0, total = 0, buckets = 0, n;
+
+	/* Each shard has its own write lock, clear them one after the other. */
+	for (size_t s = 0; s < db->shardsz; ++s) {
+		done = 0;
+
+		while (!done) {
+			start = now();
+
+			if ((n = clear(db, &db->shards[s], start, &done)) < 0)
+				break;
+
+			total += n;
+			elapsed += now() - start;
+			batches++;
+
+			log_debug("database: batch %d removed %d expired pastes from shard %zu in %lld ms",
+			    batches, n, s, now() - start);
+
+			if (!done)
+				nanosleep(&yield, NULL);
+		}
+
+		/* Buckets go at once, whatever the number of their pastes. */
+		if ((n = drop(db, &db->shards[s], time(NULL))) > 0)
+			buckets += n;
+
+		prune(db, &db->shards[s]);
+	}
+
+	log_info("database: removed %d expired pastes in %d batches (%lld ms) and %d buckets",
+	    total, batches, elapsed, buckets);
+
+	return total + buckets;
+}
+
+static int
+engine_vacuum(struct database *base, int pages)
+{
+	struct database_sqlite *db = base->data;
+	struct database_shard *sh;
+	char sql[64];
+	int before, after, left = 0;
+
+	snprintf(sql, sizeof (sql), "PRAGMA incremental_vacuum(%d)", pages);
+
+	for (size_t s = 0; s < db->shardsz; ++s) {
+		sh = &db->shards[s];
+
+		if ((before = pragma(sh, "freelist_count")) < 0)
+			goto sqlite_err;
+		if (sqlite3_exec(sh->handle, sql, NULL, NULL, NULL) != SQLITE_OK)
+			goto sqlite_err;
+		if ((after = pragma(sh, "freelist_count")) < 0)
+			goto sqlite_err;
+
+		log_info("database: reclaimed %d pages from shard %zu, %d free pages left",
+		    before - after, s, after);
+
+		left += after;
+	}
+
+	return left;
+
+sqlite_err:
+	log_warn("database: error (vacuum): %s", sqlite3_errmsg(sh->handle));
+
+	return -1;
+}
+
+static void
+engine_sync(struct database *base)
+{
+	struct database_sqlite *db = base->data;
+
+	/* Pending commits have already been written to the WAL. */
+	pthread_mutex_lock(&db->mutex);
+
+	for (size_t s = 0; s < sources(db); ++s)
+		if (source(db, s)->wal >= 0 && fsync(source(db, s)->wal) < 0)
+			log_warn("database: error (sync): %s", strerror(errno));
+
+	pthread_mutex_unlock(&db->mutex);
+}
+
+static void
+engine_finish(struct database *base)
+{
+	struct database_sqlite *db = base->data;
+	struct database_shard *sh;
+
+	if (!db)
+		return;
+
+	log_debug("database: closing (%llu statement reuses)", db->hits);
+
+	for (size_t s = 0; s < db->shardsz; ++s) {
+		sh = &db->shards[s];
+
+		if (sh->bloom.bits)
+			log_info("database: filter of shard %zu: %zu pastes, %zu bytes, "
+			    "%llu misses answered, %.2f%% false positives observed",
+			    s, sh->bloom.count, bloom_size(&sh->bloom),
+			    sh->bloom.negatives, bloom_observed(&sh->bloom) * 100);
+
+		close_shard(sh);
+	}
+
+	for (size_t b = 0; b < db->bucketsz; ++b)
+		close_shard(&db->buckets[b].shard);
+
+	pthread_mutex_destroy(&db->mutex);
+	free(db->shards);
+	free(db->buckets);
+	free(db);
+	base->data = NULL;
+}
+
+const struct database_engine database_engine_sqlite = {
+	.name           = "sqlite",
+	.open           = engine_open,
+	.get            = engine_get,
+	.insert         = engine_insert,
+	.cursor_recents = engine_cursor_recents,
+	.cursor_search  = engine_cursor_search,
+	.cursor_next    = engine_cursor_next,
+	.cursor_finish  = engine_cursor_finish,
+	.clear          = engine_clear,
+	.finish         = engine_finish,
+	.version        = engine_version,
+	.stream_open    = engine_stream_open,
+	.stream_read    = engine_stream_read,
+	.stream_close   = engine_stream_close,
+	.vacuum         = engine_vacuum,
+	.sync           = engine_sync
+};
@@ -0,0 +1,61 @@
+/*
+ * database-sqlite.h -- SQLite storage engine state
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef PASTER_DATABASE_SQLITE_H
+#define PASTER_DATABASE_SQLITE_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#include "bloom.h"
+
+struct database_shard {
+	void *handle;                   /* sqlite3 handle, the writer. */
+	void *reader;                   /* Read-only sqlite3 handle. */
+	void **stmts;                   /* Statements prepared at open. */
+	int wal;                        /* WAL file for group commit or -1. */
+	struct bloom bloom;             /* Identifiers stored in the shard. */
+	long long int version;          /* Data version the filter matches. */
+	long long int added;            /* Last journal entry in the filter. */
+};
+
+/**
+ * File holding the pastes expiring before a given time, removed as a whole
+ * once that time has passed.
+ */
+struct database_bucket {
+	long long int expires;          /* Every paste expires before. */
+	struct database_shard shard;
+};
+
+/**
+ * Data of a database opened with database_engine_sqlite.
+ */
+struct database_sqlite {
+	struct database_shard *shards;  /* One per database file. */
+	size_t shardsz;                 /* Number of shards. */
+	struct database_bucket *buckets;/* Buckets opened so far. */
+	size_t bucketsz;                /* Number of buckets. */
+	pthread_mutex_t mutex;          /* Protects buckets against database_sync. */
+	int partitioned;                /* Buckets are used or found at open. */
+	int maintenance;                /* No filter nor group commit. */
+	char path[PATH_MAX];            /* Path of the first shard. */
+	unsigned long long hits;        /* Prepared statement reuses. */
+};
+
+#endif /* !PASTER_DATABASE_SQLITE_H */
@@ -1,5 +1,5 @@
 /*
- * database.c -- sqlite storage
+ * database.c -- paste storage
  *
  * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
  *
@@ -15,160 +15,290 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
-
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
-#include <sqlite3.h>
-
+#include "config.h"
 #include "database.h"
 #include "log.h"
 #include "paste.h"
 #include "util.h"
 
-#include "sql/clear.h"
-#include "sql/get.h"
-#include "sql/init.h"
-#include "sql/insert.h"
-#include "sql/recents.h"
-#include "sql/search.h"
+/*
+ * Longest time in milliseconds a commit waits for others to share its sync
+ * when only the group commit size is configured.
+ */
+#define COMMIT_WINDOW 10
 
-#define CHAR(sql) (const char *)(sql)
+static const struct database_engine * const engines[] = {
+	&database_engine_sqlite,
+	&database_engine_log
+};
 
-static char *
-dup(const unsigned char *s)
+struct database database;
+
+static int
+full(const struct database *db)
+{
+	return config.commitrows && db->committed - db->synced >= config.commitrows;
+}
+
+/*
+ * Group commit: inserts commit without syncing and wait for this thread,
+ * which syncs once for all of them when commitrows are waiting or the first
+ * one has waited for the commit window.
+ */
+static void *
+flush(void *data)
 {
-	return estrdup(s ? (const char *)(s) : "");
+	struct database *db = data;
+	const unsigned int window = config.commitwindow ? config.commitwindow : COMMIT_WINDOW;
+	struct timespec deadline;
+	sigset_t sigs;
+
+	sigemptyset(&sigs);
+	sigfillset(&sigs);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	pthread_mutex_lock(&db->mutex);
+
+	while (db->flushing) {
+		if (db->committed == db->synced) {
+			pthread_cond_wait(&db->pending, &db->mutex);
+			continue;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += window / 1000;
+		deadline.tv_nsec += (window % 1000) * 1000000L;
+
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (db->flushing && !full(db) &&
+		    pthread_cond_timedwait(&db->pending, &db->mutex, &deadline) != ETIMEDOUT)
+			continue;
+
+		pthread_mutex_unlock(&db->mutex);
+		database_sync(db);
+		pthread_mutex_lock(&db->mutex);
+	}
+
+	pthread_mutex_unlock(&db->mutex);
+
+	return NULL;
 }
 
 static void
-convert(sqlite3_stmt *stmt, struct paste *paste)
+destroy(struct database *db)
 {
-	paste->id = dup(sqlite3_column_text(stmt, 0));
-	paste->title = dup(sqlite3_column_text(stmt, 1));
-	paste->author = dup(sqlite3_column_text(stmt, 2));
-	paste->language = dup(sqlite3_column_text(stmt, 3));
-	paste->code = dup(sqlite3_column_text(stmt, 4));
-	paste->timestamp = sqlite3_column_int64(stmt, 5);
-	paste->visible = sqlite3_column_int(stmt, 6);
-	paste->duration = sqlite3_column_int64(stmt, 7);
+	pthread_cond_destroy(&db->flushed);
+	pthread_cond_destroy(&db->pending);
+	pthread_mutex_destroy(&db->mutex);
+	memset(db, 0, sizeof (*db));
 }
 
 static int
-exists(struct database *db, const char *id)
+start(struct database *db, const char *path, int maintenance)
 {
-	assert(id);
+	int rc;
 
-	sqlite3_stmt *stmt = NULL;
-	int ret = 1;
+	memset(db, 0, sizeof (*db));
+	db->maintenance = maintenance;
+	pthread_mutex_init(&db->mutex, NULL);
+	pthread_cond_init(&db->pending, NULL);
+	pthread_cond_init(&db->flushed, NULL);
 
-	if (sqlite3_prepare(db->handle, CHAR(sql_get), -1, &stmt, NULL) == SQLITE_OK) {
-		sqlite3_bind_text(stmt, 1, id, -1, NULL);
-		ret = sqlite3_step(stmt) == SQLITE_ROW;
-		sqlite3_finalize(stmt);
-	}
+	for (size_t i = 0; i < NELEM(engines); ++i)
+		if (strcmp(engines[i]->name, config.databaseengine) == 0)
+			db->engine = engines[i];
 
-	return ret;
-}
+	if (!db->engine) {
+		log_warn("database: unknown engine %s", config.databaseengine);
+		destroy(db);
 
-static const char *
-create_id(void)
-{
-	static const char table[] = "abcdefghijklmnopqrstuvwxyz1234567890";
-	static char id[12];
+		return -1;
+	}
 
-	for (size_t i = 0; i < sizeof (id); ++i)
-		id[i] = table[rand() % (sizeof (table) - 1)];
+	cache_init(&db->cache, maintenance ? 0 : config.cachesize);
 
-	return id;
-}
+	if (db->engine->open(db, path) < 0) {
+		cache_finish(&db->cache);
+		destroy(db);
 
-static int
-set_id(struct database *db, struct paste *paste)
-{
-	assert(paste);
+		return -1;
+	}
 
-	paste->id = NULL;
+	db->flushing = db->grouped;
 
-	/*
-	 * Avoid infinite loop, we only try to create a new id in 30 steps.
-	 *
-	 * On error, the function `exist` returns true to indicate we should
-	 * not try to save with that id.
-	 */
-	int tries = 0;
+	if (db->grouped && (rc = pthread_create(&db->flusher, NULL, flush, db)) != 0) {
+		log_warn("database: unable to start group commit: %s", strerror(rc));
+		db->engine->finish(db);
+		cache_finish(&db->cache);
+		destroy(db);
 
-	do {
-		free(paste->id);
-		paste->id = estrdup(create_id());
-	} while (++tries < 30 && exists(db, paste->id));
+		return -1;
+	}
 
-	return tries < 30 ? 0 : -1;
+	return 0;
 }
 
-struct database database;
-
 int
 database_open(struct database *db, const char *path)
 {
 	assert(db);
 	assert(path);
 
-	log_info("database: opening %s", path);
+	return start(db, path, 0);
+}
 
-	if (sqlite3_open(path, (sqlite3 **)&db->handle) != SQLITE_OK) {
-		log_warn("database: unable to open %s: %s", path, sqlite3_errmsg(db->handle));
-		return -1;
+int
+database_open_maintenance(struct database *db, const char *path)
+{
+	assert(db);
+	assert(path);
+
+	return start(db, path, 1);
+}
+
+static char *
+text(const struct database_text *t)
+{
+	char *s = ecalloc(1, t->len + 1);
+
+	if (t->len)
+		memcpy(s, t->data, t->len);
+
+	return s;
+}
+
+/*
+ * Copy every row of the cursor and close it.
+ */
+static int
+collect(struct database_cursor *cursor, struct paste *pastes, size_t *max)
+{
+	const struct database_row *row = &cursor->row;
+	size_t n = 0;
+	int rc = 0;
+
+	memset(pastes, 0, *max * sizeof (struct paste));
+
+	while (n < *max && (rc = database_cursor_next(cursor)) > 0) {
+		pastes[n].id = text(&row->id);
+		pastes[n].title = text(&row->title);
+		pastes[n].author = text(&row->author);
+		pastes[n].language = text(&row->language);
+		pastes[n].snippet = row->snippet.data ? text(&row->snippet) : NULL;
+		pastes[n].timestamp = row->timestamp;
+		pastes[n].visible = row->visible;
+		pastes[n++].duration = row->duration;
 	}
 
-	/* Wait for 30 seconds to lock the database. */
-	sqlite3_busy_timeout(db->handle, 30000);
+	database_cursor_finish(cursor);
 
-	if (sqlite3_exec(db->handle, CHAR(sql_init), NULL, NULL, NULL) != SQLITE_OK) {
-		log_warn("database: unable to initialize %s: %s", path, sqlite3_errmsg(db->handle));
-		return -1;
+	if (rc < 0) {
+		while (n)
+			paste_finish(&pastes[--n]);
 	}
 
-	return 0;
+	*max = n;
+	log_debug("database: found %zu pastes", n);
+
+	return rc < 0 ? -1 : 0;
 }
 
 int
-database_recents(struct database *db, struct paste *pastes, size_t *max)
+database_recents(struct database *db,
+                 struct paste *pastes,
+                 size_t *max,
+                 const struct paste *after)
 {
 	assert(db);
 	assert(pastes);
 	assert(max);
 
-	sqlite3_stmt *stmt = NULL;
-	size_t i = 0;
+	struct database_cursor cursor;
 
-	memset(pastes, 0, *max * sizeof (struct paste));
-	log_debug("database: accessing most recents");
+	if (database_cursor_recents(db, &cursor, *max, after) < 0) {
+		memset(pastes, 0, *max * sizeof (struct paste));
+		*max = 0;
 
-	if (sqlite3_prepare(db->handle, CHAR(sql_recents), -1, &stmt, NULL) != SQLITE_OK ||
-	    sqlite3_bind_int64(stmt, 1, *max) != SQLITE_OK)
-		goto sqlite_err;
+		return -1;
+	}
 
-	for (; i < *max && sqlite3_step(stmt) == SQLITE_ROW; ++i)
-		convert(stmt, &pastes[i]);
+	return collect(&cursor, pastes, max);
+}
 
-	log_debug("database: found %zu pastes", i);
-	sqlite3_finalize(stmt);
-	*max = i;
+static void
+retire(struct database_recents *recents)
+{
+	if (!recents)
+		return;
 
-	return 0;
+	for (size_t i = 0; i < recents->pastesz; ++i)
+		paste_finish(&recents->pastes[i]);
+
+	free(recents);
+}
+
+/*
+ * Replace the snapshot with a single pointer store, the previous one is kept
+ * for one more generation so that a reader still holding it is not affected.
+ */
+static void
+publish(struct database *db, struct database_recents *recents)
+{
+	retire(db->retired);
+	db->retired = __atomic_exchange_n(&db->recents, recents, __ATOMIC_ACQ_REL);
+	db->stale = 0;
+}
+
+const struct database_recents *
+database_recents_snapshot(struct database *db)
+{
+	assert(db);
+
+	struct database_recents *recents = __atomic_load_n(&db->recents, __ATOMIC_ACQUIRE);
+	long long int v = 0;
+	time_t expires;
+
+	/* Our own changes mark it stale, other processes change the version. */
+	if (db->engine->version && (v = db->engine->version(db)) < 0)
+		return NULL;
+	if (recents && !db->stale && v == recents->version &&
+	    (!recents->expires || time(NULL) < recents->expires))
+		return recents;
 
-sqlite_err:
-	log_warn("database: error (recents): %s\n", sqlite3_errmsg(db->handle));
+	log_debug("database: rebuilding recent pastes snapshot");
 
-	if (stmt)
-		sqlite3_finalize(stmt);
+	/* Version first, a commit in between only causes another rebuild. */
+	recents = ecalloc(1, sizeof (*recents));
+	recents->version = v;
+	recents->pastesz = NELEM(recents->pastes);
 
-	*max = 0;
+	if (database_recents(db, recents->pastes, &recents->pastesz, NULL) < 0) {
+		free(recents);
+		return NULL;
+	}
+
+	/* Listings hide expired pastes, so must the snapshot. */
+	for (size_t i = 0; i < recents->pastesz; ++i) {
+		expires = recents->pastes[i].timestamp + recents->pastes[i].duration;
 
-	return -1;
+		if (!recents->expires || expires < recents->expires)
+			recents->expires = expires;
+	}
+
+	publish(db, recents);
+
+	return recents;
 }
 
 int
@@ -178,39 +308,97 @@ database_get(struct database *db, struct paste *paste, const char *id)
 	assert(paste);
 	assert(id);
 
-	sqlite3_stmt* stmt = NULL;
-	int found = -1;
-
-	memset(paste, 0, sizeof (struct paste));
-	log_debug("database: accessing paste with id: %s", id);
-
-	if (sqlite3_prepare(db->handle, CHAR(sql_get), -1, &stmt, NULL) != SQLITE_OK ||
-	    sqlite3_bind_text(stmt, 1, id, -1, NULL) != SQLITE_OK)
-		goto sqlite_err;
-
-	switch (sqlite3_step(stmt)) {
-	case SQLITE_ROW:
-		convert(stmt, paste);
-		found = 0;
-		break;
-	case SQLITE_MISUSE:
-	case SQLITE_ERROR:
-		goto sqlite_err;
-	default:
-		break;
+	int rc;
+
+	/* Pastes never change, only their expiration matters. */
+	if (cache_get(&db->cache, paste, id) == 0)
+		return 0;
+	if ((rc = db->engine->get(db, paste, id, PASTE_ENCODING_IDENTITY)) == 0)
+		cache_put(&db->cache, paste);
+
+	return rc;
+}
+
+int
+database_get_encoded(struct database *db,
+                     struct paste *paste,
+                     const char *id,
+                     enum paste_encoding accept)
+{
+	assert(db);
+	assert(paste);
+	assert(id);
+
+	if (accept == PASTE_ENCODING_IDENTITY)
+		return database_get(db, paste, id);
+
+	return db->engine->get(db, paste, id, accept);
+}
+
+int
+database_stream_open(struct database *db,
+                     struct database_stream *stream,
+                     struct paste *paste,
+                     const char *id,
+                     enum paste_encoding accept)
+{
+	assert(db);
+	assert(stream);
+	assert(paste);
+	assert(id);
+
+	if (db->engine->stream_open) {
+		if (db->engine->stream_open(db, stream, paste, id, accept) < 0)
+			return -1;
+
+		stream->engine = db->engine;
+
+		return 0;
 	}
 
-	sqlite3_finalize(stmt);
+	memset(stream, 0, sizeof (*stream));
 
-	return found;
+	/* Not from the cache, the stream takes the code over. */
+	if (db->engine->get(db, paste, id, accept) < 0)
+		return -1;
+
+	stream->data = paste->code;
+	stream->size = paste->codesz;
+	paste->code = NULL;
+
+	return 0;
+}
+
+long long int
+database_stream_read(struct database_stream *stream, void *buf, size_t bufsz)
+{
+	assert(stream);
+	assert(buf);
+
+	size_t n;
 
-sqlite_err:
-	if (stmt)
-		sqlite3_finalize(stmt);
+	if (stream->engine)
+		return stream->engine->stream_read(stream, buf, bufsz);
 
-	log_warn("database: error (get): %s", sqlite3_errmsg(db->handle));
+	n = stream->size - stream->offset;
+	n = n < bufsz ? n : bufsz;
+	memcpy(buf, stream->data + stream->offset, n);
+	stream->offset += n;
 
-	return -1;
+	return n;
+}
+
+void
+database_stream_close(struct database_stream *stream)
+{
+	assert(stream);
+
+	if (stream->engine)
+		stream->engine->stream_close(stream);
+	else {
+		free(stream->data);
+		memset(stream, 0, sizeof (*stream));
+	}
 }
 
 int
@@ -219,52 +407,56 @@ database_insert(struct database *db, struct paste *paste)
 	assert(db);
 	assert(paste);
 
-	sqlite3_stmt *stmt = NULL;
+	const char *code = paste->code ? paste->code : "";
+
+	return database_insert_code(db, paste, code, strlen(code));
+}
+
+int
+database_insert_code(struct database *db, struct paste *paste, const char *code, size_t len)
+{
+	assert(db);
+	assert(paste);
+	assert(code || len == 0);
+
+	unsigned long long seq;
 
 	log_debug("database: creating new paste");
 
-	if (sqlite3_exec(db->handle, "BEGIN EXCLUSIVE TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) {
-		log_warn("database: could not lock database: %s", sqlite3_errmsg(db->handle));
+	paste->id = NULL;
+
+	if (config.maxsize && len > config.maxsize) {
+		log_warn("database: error (insert): paste of %zu bytes is too large", len);
 		return -1;
 	}
-	if (set_id(db, paste) < 0) {
-		log_warn("database: unable to randomize unique identifier");
-		sqlite3_exec(db->handle, "END TRANSACTION", NULL, NULL, NULL);
+
+	if (db->engine->insert(db, paste, code ? code : "", len) < 0) {
+		if (!paste->arena)
+			free(paste->id);
+		paste->id = NULL;
+
 		return -1;
 	}
-	if (sqlite3_prepare(db->handle, CHAR(sql_insert), -1, &stmt, NULL) != SQLITE_OK)
-		goto sqlite_err;
 
-	sqlite3_bind_text(stmt, 1, paste->id, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 2, paste->title, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 3, paste->author, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 4, paste->language, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 5, paste->code, -1, SQLITE_STATIC);
-	sqlite3_bind_int(stmt, 6, paste->visible);
-	sqlite3_bind_int64(stmt, 7, paste->duration);
+	/* Not acknowledged before the flusher has synced it. */
+	if (db->grouped) {
+		pthread_mutex_lock(&db->mutex);
+		seq = ++db->committed;
+		pthread_cond_signal(&db->pending);
+
+		while (db->synced < seq)
+			pthread_cond_wait(&db->flushed, &db->mutex);
 
-	if (sqlite3_step(stmt) != SQLITE_DONE)
-		goto sqlite_err;
+		pthread_mutex_unlock(&db->mutex);
+	}
 
-	sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
-	sqlite3_finalize(stmt);
+	if (paste->visible)
+		db->stale = 1;
 
 	log_info("database: new paste (%s) from %s expires in one %lld seconds",
 	    paste->id, paste->author, paste->duration);
 
 	return 0;
-
-sqlite_err:
-	log_warn("database: error (insert): %s", sqlite3_errmsg(db->handle));
-	sqlite3_exec(db->handle, "ROLLBACK", NULL, NULL, NULL);
-
-	if (stmt)
-		sqlite3_finalize(stmt);
-
-	free(paste->id);
-	paste->id = NULL;
-
-	return -1;
 }
 
 int
@@ -273,56 +465,92 @@ database_search(struct database *db,
                 size_t *max,
                 const char *title,
                 const char *author,
-                const char *language)
+                const char *language,
+                const char *query,
+                const struct paste *after)
 {
 	assert(db);
 	assert(pastes);
 	assert(max);
 
-	sqlite3_stmt *stmt = NULL;
-	size_t i = 0;
+	struct database_cursor cursor;
 
-	log_debug("database: searching title=%s, author=%s, language=%s",
+	if (database_cursor_search(db, &cursor, *max, title, author, language, query, after) < 0) {
+		memset(pastes, 0, *max * sizeof (struct paste));
+		*max = 0;
+
+		return -1;
+	}
+
+	return collect(&cursor, pastes, max);
+}
+
+int
+database_cursor_recents(struct database *db,
+                        struct database_cursor *cursor,
+                        size_t max,
+                        const struct paste *after)
+{
+	assert(db);
+	assert(cursor);
+
+	memset(cursor, 0, sizeof (*cursor));
+	cursor->engine = db->engine;
+	cursor->max = max;
+
+	return db->engine->cursor_recents(db, cursor, after);
+}
+
+int
+database_cursor_search(struct database *db,
+                       struct database_cursor *cursor,
+                       size_t max,
+                       const char *title,
+                       const char *author,
+                       const char *language,
+                       const char *query,
+                       const struct paste *after)
+{
+	assert(db);
+	assert(cursor);
+
+	log_debug("database: searching title=%s, author=%s, language=%s, query=%s",
 	    title    ? title    : "",
 	    author   ? author   : "",
-	    language ? language : "");
+	    language ? language : "",
+	    query    ? query    : "");
 
-	memset(pastes, 0, *max * sizeof (struct paste));
+	memset(cursor, 0, sizeof (*cursor));
+	cursor->engine = db->engine;
+	cursor->max = max;
 
-	/* Select everything if not specified. */
-	title    = title    ? title    : "%";
-	author   = author   ? author   : "%";
-	language = language ? language : "%";
-
-	if (sqlite3_prepare(db->handle, CHAR(sql_search), -1, &stmt, NULL) != SQLITE_OK)
-		goto sqlite_err;
-	if (sqlite3_bind_text(stmt, 1, title, -1, NULL) != SQLITE_OK)
-		goto sqlite_err;
-	if (sqlite3_bind_text(stmt, 2, author, -1, NULL) != SQLITE_OK)
-		goto sqlite_err;
-	if (sqlite3_bind_text(stmt, 3, language, -1, NULL) != SQLITE_OK)
-		goto sqlite_err;
-	if (sqlite3_bind_int64(stmt, 4, *max) != SQLITE_OK)
-		goto sqlite_err;
-
-	for (; i < *max && sqlite3_step(stmt) == SQLITE_ROW; ++i)
-		convert(stmt, &pastes[i]);
-
-	log_debug("database: found %zu pastes", i);
-	sqlite3_finalize(stmt);
-	*max = i;
+	return db->engine->cursor_search(db, cursor, title, author, language, query, after);
+}
 
-	return 0;
+int
+database_cursor_next(struct database_cursor *cursor)
+{
+	assert(cursor);
+
+	int rc;
 
-sqlite_err:
-	log_warn("database: error (search): %s\n", sqlite3_errmsg(db->handle));
+	if (cursor->count == cursor->max)
+		return 0;
+	if ((rc = cursor->engine->cursor_next(cursor)) > 0)
+		cursor->count++;
+
+	return rc;
+}
 
-	if (stmt)
-		sqlite3_finalize(stmt);
+void
+database_cursor_finish(struct database_cursor *cursor)
+{
+	assert(cursor);
 
-	*max = 0;
+	if (cursor->engine)
+		cursor->engine->cursor_finish(cursor);
 
-	return -1;
+	memset(cursor, 0, sizeof (*cursor));
 }
 
 void
@@ -332,8 +560,44 @@ database_clear(struct database *db)
 
 	log_debug("database: clearing deprecated pastes");
 
-	if (sqlite3_exec(db->handle, CHAR(sql_clear), NULL, NULL, NULL) != SQLITE_OK)
-		log_warn("database: error (clear): %s\n", sqlite3_errmsg(db->handle));
+	if (db->engine->clear(db) > 0)
+		db->stale = 1;
+}
+
+int
+database_vacuum(struct database *db, int pages)
+{
+	assert(db);
+	assert(pages > 0);
+
+	return db->engine->vacuum ? db->engine->vacuum(db, pages) : 0;
+}
+
+void
+database_sync(struct database *db)
+{
+	assert(db);
+
+	unsigned long long target, pending;
+
+	pthread_mutex_lock(&db->mutex);
+	target = db->committed;
+	pending = target - db->synced;
+	pthread_mutex_unlock(&db->mutex);
+
+	if (!pending)
+		return;
+	if (db->engine->sync)
+		db->engine->sync(db);
+
+	pthread_mutex_lock(&db->mutex);
+
+	if (target > db->synced)
+		db->synced = target;
+
+	pthread_cond_broadcast(&db->flushed);
+	pthread_mutex_unlock(&db->mutex);
+	log_debug("database: synced %llu commits", pending);
 }
 
 void
@@ -341,7 +605,24 @@ database_finish(struct database *db)
 {
 	assert(db);
 
-	log_debug("database: closing");
-	sqlite3_close(db->handle);
-	db->handle = NULL;
+	if (!db->engine)
+		return;
+
+	log_debug("database: closing (%llu cache hits, %llu misses)",
+	    db->cache.hits, db->cache.misses);
+
+	if (db->grouped) {
+		pthread_mutex_lock(&db->mutex);
+		db->flushing = 0;
+		pthread_cond_signal(&db->pending);
+		pthread_mutex_unlock(&db->mutex);
+		pthread_join(db->flusher, NULL);
+	}
+
+	database_sync(db);
+	db->engine->finish(db);
+	cache_finish(&db->cache);
+	retire(db->recents);
+	retire(db->retired);
+	destroy(db);
 }
@@ -19,12 +19,152 @@
 #ifndef PASTER_DATABASE_H
 #define PASTER_DATABASE_H
 
+#include <pthread.h>
 #include <stddef.h>
 
-struct paste;
+#include "cache.h"
+#include "paste.h"
+
+/* Number of pastes in the recent pastes snapshot. */
+#define DATABASE_RECENTS 16
+
+/* Size of the chunks read by database_stream_read. */
+#define DATABASE_STREAM_CHUNK 65536
+
+/**
+ * Incremental reader of a paste body, see database_stream_open.
+ */
+struct database_stream {
+	const struct database_engine *engine; /* Engine reading by chunks. */
+	void *handle;                   /* sqlite3 handle. */
+	void *blob;                     /* sqlite3_blob of the body. */
+	char *data;                     /* Body read at once otherwise. */
+	struct gzip *inflater;          /* Decoder if sent decompressed. */
+	size_t offset;                  /* Bytes of the body already read. */
+	size_t size;                    /* Size of the body. */
+	const void *next;               /* Compressed input left in in. */
+	size_t inlen;                   /* Bytes left at next. */
+	int end;                        /* Decoder reached the end. */
+	unsigned char in[DATABASE_STREAM_CHUNK];
+};
+
+/**
+ * Immutable list of the most recent public pastes, see
+ * database_recents_snapshot.
+ */
+struct database_recents {
+	struct paste pastes[DATABASE_RECENTS];
+	size_t pastesz;                 /* Number of pastes. */
+	long long int version;          /* Engine version when built. */
+	time_t expires;                 /* First paste expiration or 0. */
+};
+
+/**
+ * Text borrowed from the engine, not NUL terminated.
+ */
+struct database_text {
+	const char *data;
+	size_t len;
+};
+
+/**
+ * Listing row, its texts are only valid until the next row.
+ */
+struct database_row {
+	struct database_text id;
+	struct database_text title;
+	struct database_text author;
+	struct database_text language;
+	struct database_text snippet;   /* Only set by full text searches. */
+	time_t timestamp;
+	int visible;
+	int duration;
+};
+
+/**
+ * Listing read one row at a time, see database_cursor_recents.
+ */
+struct database_cursor {
+	const struct database_engine *engine;
+	void *data;                     /* Engine state. */
+	size_t max;                     /* Rows asked for. */
+	size_t count;                   /* Rows read so far. */
+	struct database_row row;        /* Current row. */
+};
+
+struct database;
+
+/**
+ * Storage engine, the database functions below check their arguments,
+ * handle the cache and call the engine.
+ */
+struct database_engine {
+	const char *name;
+
+	/* Store the engine state in the database data field. */
+	int (*open)(struct database *, const char *);
+	int (*get)(struct database *, struct paste *, const char *, enum paste_encoding);
+
+	/* Set a new paste identifier, the code is not NUL terminated. */
+	int (*insert)(struct database *, struct paste *, const char *, size_t);
+
+	/* Start listings of at most cursor->max rows, finished on errors. */
+	int (*cursor_recents)(struct database *, struct database_cursor *, const struct paste *);
+	int (*cursor_search)(struct database *,
+	                     struct database_cursor *,
+	                     const char *,
+	                     const char *,
+	                     const char *,
+	                     const char *,
+	                     const struct paste *);
+
+	/* Set the cursor row and return 1, 0 at the end or -1 on errors. */
+	int (*cursor_next)(struct database_cursor *);
+	void (*cursor_finish)(struct database_cursor *);
+
+	/* Return the number of pastes removed or -1. */
+	int (*clear)(struct database *);
+	void (*finish)(struct database *);
+
+	/* Optional. Changes when other processes modify the pastes. */
+	long long int (*version)(struct database *);
+
+	/* Optional. Without them the body is read at once by get. */
+	int (*stream_open)(struct database *,
+	                   struct database_stream *,
+	                   struct paste *,
+	                   const char *,
+	                   enum paste_encoding);
+	long long int (*stream_read)(struct database_stream *, void *, size_t);
+	void (*stream_close)(struct database_stream *);
+
+	/* Optional. */
+	int (*vacuum)(struct database *, int);
+	void (*sync)(struct database *);
+};
+
+/* SQLite database, the default. */
+extern const struct database_engine database_engine_sqlite;
+
+/* Append-only log file indexed in memory. */
+extern const struct database_engine database_engine_log;
 
 struct database {
-	void *handle;
+	const struct database_engine *engine;
+	void *data;                     /* Engine state. */
+	int maintenance;                /* Only cleared and vacuumed. */
+	int grouped;                    /* Engine syncs in database_sync. */
+	unsigned long long committed;   /* Commits waiting or synced. */
+	unsigned long long synced;      /* Commits synced. */
+	int flushing;                   /* Flusher thread running. */
+	pthread_t flusher;
+	pthread_mutex_t mutex;          /* Protects the fields above. */
+	pthread_cond_t pending;         /* Wakes up the flusher. */
+	pthread_cond_t flushed;         /* Wakes up the waiting commits. */
+	struct cache cache;             /* Pastes recently accessed. */
+	struct database_recents *recents; /* Current snapshot. */
+	struct database_recents *retired; /* Previous snapshot. */
+	int stale;                      /* Snapshot outdated by this process. */
 };
 
 /**
@@ -34,29 +174,196 @@ struct database {
  */
 extern struct database database;
 
+/**
+ * Open the database at path with the engine named in the configuration.
+ *
+ * With the SQLite engine and more than one shard in the configuration
+ * pastes are spread over path, path.1, path.2 and so on.
+ *
+ * With group commit in the configuration and an engine supporting it, a
+ * thread is started to sync the new pastes.
+ */
 int
 database_open(struct database *, const char *);
 
+/**
+ * Open the database like database_open for database_clear and
+ * database_vacuum only: the identifier filters, the cache and the group
+ * commit thread, which only serve pastes, are left out.
+ */
 int
-database_recents(struct database *, struct paste *, size_t *);
+database_open_maintenance(struct database *, const char *);
+
+/**
+ * Fill at most *max most recent public pastes, *max is set to the number of
+ * pastes found.
+ *
+ * Listings are paginated by (date, id): if after is not NULL only pastes
+ * older than it are returned, its timestamp and id fields are used as the
+ * key so it is usually the last paste of the previous page.
+ *
+ * Listings only fetch the paste metadata, the code field is left NULL.
+ */
+int
+database_recents(struct database *,
+                 struct paste *,
+                 size_t *,
+                 const struct paste *);
+
+/**
+ * Return the most recent public pastes from memory, the snapshot is only
+ * rebuilt after pastes are created or removed, including by other
+ * processes, or once one of its pastes has expired.
+ *
+ * The snapshot belongs to the database, it must not be modified and stays
+ * valid until the snapshot after the next one is built.
+ *
+ * Returns NULL on errors.
+ */
+const struct database_recents *
+database_recents_snapshot(struct database *);
 
+/**
+ * Fill the paste with the given id, the paste must be zeroed or have only
+ * its arena set, its strings then come from that arena. Its code may be
+ * shared with the cache and must not be modified.
+ */
 int
 database_get(struct database *, struct paste *, const char *);
 
+/**
+ * Like database_get but if the body is stored with the accepted encoding it
+ * is returned as is, the paste encoding and codesz fields describe it.
+ */
+int
+database_get_encoded(struct database *,
+                     struct paste *,
+                     const char *,
+                     enum paste_encoding);
+
+/**
+ * Open the body of a paste for reading by chunks, so that its size in
+ * memory does not depend on the paste size.
+ *
+ * Paste metadata are filled like database_get but the code field is left
+ * NULL, the encoding and codesz fields describe the bytes that
+ * database_stream_read will return: the stored body if it is stored with
+ * the accepted encoding, the plain text otherwise.
+ *
+ * Returns -1 if not found or on error, otherwise the stream must be closed
+ * with database_stream_close.
+ */
+int
+database_stream_open(struct database *,
+                     struct database_stream *,
+                     struct paste *,
+                     const char *,
+                     enum paste_encoding);
+
+/**
+ * Read the next bytes of the body into the buffer.
+ *
+ * Returns the number of bytes read, 0 at the end and -1 on errors.
+ */
+long long int
+database_stream_read(struct database_stream *, void *, size_t);
+
+void
+database_stream_close(struct database_stream *);
+
 int
 database_insert(struct database *, struct paste *);
 
+/**
+ * Like database_insert but with the code given apart from the paste and
+ * not copied: it is written into the database by chunks, compressed on the
+ * fly if configured.
+ *
+ * Pastes larger than config.maxsize are refused before anything is
+ * stored. With group commit, it returns once the paste is synced along with
+ * the others committed meanwhile.
+ */
+int
+database_insert_code(struct database *, struct paste *, const char *, size_t);
+
+/**
+ * Search public pastes by title and author substrings, language and words
+ * in title or code. Every criterion may be NULL to match any.
+ *
+ * Like database_recents, results start after the optional last paste of the
+ * previous page and the code field is left NULL. Results of a query on words
+ * are ordered by relevance instead and only the first page is available.
+ */
 int
 database_search(struct database *,
                 struct paste *,
                 size_t *,
                 const char *,
                 const char *,
-                const char *);
+                const char *,
+                const char *,
+                const struct paste *);
+
+/**
+ * Start reading the listing of database_recents one row at a time without
+ * copying anything, the texts of a row are borrowed from the engine until
+ * the next one. At most max rows are read.
+ *
+ * Only one cursor may be open on a database at a time, it must be closed
+ * with database_cursor_finish unless opening it failed.
+ */
+int
+database_cursor_recents(struct database *,
+                        struct database_cursor *,
+                        size_t,
+                        const struct paste *);
+
+/**
+ * Like database_cursor_recents for the listing of database_search, the
+ * criteria must stay valid until the cursor is closed.
+ */
+int
+database_cursor_search(struct database *,
+                       struct database_cursor *,
+                       size_t,
+                       const char *,
+                       const char *,
+                       const char *,
+                       const char *,
+                       const struct paste *);
+
+/**
+ * Move to the next row, return 1 if there is one, 0 at the end of the
+ * listing or -1 on errors.
+ */
+int
+database_cursor_next(struct database_cursor *);
+
+void
+database_cursor_finish(struct database_cursor *);
 
 void
 database_clear(struct database *);
 
+/**
+ * Return at most pages free pages to the file system, pages must be
+ * positive.
+ *
+ * Return the number of free pages left or -1 on error, engines without
+ * pages always have 0 left.
+ */
+int
+database_vacuum(struct database *, int);
+
+/**
+ * With group commit enabled, flush the pastes committed since the last call
+ * to stable storage and wake up the inserts waiting for it. It is called by
+ * the thread started in database_open and may be called concurrently with
+ * the other functions.
+ */
+void
+database_sync(struct database *);
+
 void
 database_finish(struct database *);
 
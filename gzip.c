@@ -0,0 +1,244 @@
+/*
+ * gzip.c -- gzip compression of paste bodies
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "gzip.h"
+#include "util.h"
+
+/* Adding 16 to the window bits selects the gzip wrapper instead of zlib. */
+#define WINDOW (15 + 16)
+
+void *
+gzip_compress(const void *data, size_t len, size_t *outlen)
+{
+	assert(data);
+	assert(outlen);
+
+	z_stream zs = {0};
+	unsigned char *out;
+	size_t max;
+
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, WINDOW, 8,
+	    Z_DEFAULT_STRATEGY) != Z_OK)
+		return NULL;
+
+	max = deflateBound(&zs, len);
+	out = ecalloc(1, max);
+
+	zs.next_in = (unsigned char *)data;
+	zs.avail_in = len;
+	zs.next_out = out;
+	zs.avail_out = max;
+
+	if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+		deflateEnd(&zs);
+		free(out);
+		return NULL;
+	}
+
+	*outlen = zs.total_out;
+	deflateEnd(&zs);
+
+	return out;
+}
+
+char *
+gzip_decompress(const void *data, size_t len, size_t *outlen)
+{
+	assert(data || len == 0);
+	assert(outlen);
+
+	const unsigned char *in = data;
+	z_stream zs = {0};
+	char *out, *tmp;
+	size_t max;
+	int rc;
+
+	/* The gzip trailer ends with the uncompressed size modulo 2^32. */
+	if (len < 18)
+		return NULL;
+
+	max = gzip_stream_size(&in[len - 4]) + 1;
+
+	if (inflateInit2(&zs, WINDOW) != Z_OK)
+		return NULL;
+
+	out = ecalloc(1, max);
+	zs.next_in = (unsigned char *)in;
+	zs.avail_in = len;
+
+	for (;;) {
+		zs.next_out = (unsigned char *)out + zs.total_out;
+		zs.avail_out = max - zs.total_out - 1;
+
+		if ((rc = inflate(&zs, Z_FINISH)) == Z_STREAM_END)
+			break;
+
+		/* Only a lack of output space is recoverable. */
+		if (rc != Z_BUF_ERROR || zs.avail_out != 0)
+			goto err;
+
+		/* The size hint is wrong for bodies of 4GiB and more. */
+		if (!(tmp = realloc(out, max * 2)))
+			goto err;
+
+		out = tmp;
+		max *= 2;
+	}
+
+	out[zs.total_out] = '\0';
+	*outlen = zs.total_out;
+	inflateEnd(&zs);
+
+	return out;
+
+err:
+	inflateEnd(&zs);
+	free(out);
+
+	return NULL;
+}
+
+struct gzip {
+	z_stream zs;
+	int deflating;
+};
+
+struct gzip *
+gzip_stream_open(void)
+{
+	struct gzip *gz = ecalloc(1, sizeof (*gz));
+
+	if (inflateInit2(&gz->zs, WINDOW) != Z_OK) {
+		free(gz);
+		return NULL;
+	}
+
+	return gz;
+}
+
+struct gzip *
+gzip_stream_deflater(void)
+{
+	struct gzip *gz = ecalloc(1, sizeof (*gz));
+
+	if (deflateInit2(&gz->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, WINDOW, 8,
+	    Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(gz);
+		return NULL;
+	}
+
+	gz->deflating = 1;
+
+	return gz;
+}
+
+int
+gzip_stream_deflate(struct gzip *gz, const void **in, size_t *inlen, void *out, size_t *outlen)
+{
+	assert(gz);
+	assert(gz->deflating);
+	assert(in);
+	assert(inlen);
+	assert(out);
+	assert(outlen);
+
+	int rc;
+
+	gz->zs.next_in = (unsigned char *)*in;
+	gz->zs.avail_in = *inlen;
+	gz->zs.next_out = out;
+	gz->zs.avail_out = *outlen;
+
+	rc = deflate(&gz->zs, Z_FINISH);
+
+	*outlen -= gz->zs.avail_out;
+	*in = gz->zs.next_in;
+	*inlen = gz->zs.avail_in;
+
+	switch (rc) {
+	case Z_STREAM_END:
+		return 1;
+	case Z_OK:
+	case Z_BUF_ERROR:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+int
+gzip_stream_inflate(struct gzip *gz, const void **in, size_t *inlen, void *out, size_t *outlen)
+{
+	assert(gz);
+	assert(!gz->deflating);
+	assert(in);
+	assert(inlen);
+	assert(out);
+	assert(outlen);
+
+	int rc;
+
+	gz->zs.next_in = (unsigned char *)*in;
+	gz->zs.avail_in = *inlen;
+	gz->zs.next_out = out;
+	gz->zs.avail_out = *outlen;
+
+	rc = inflate(&gz->zs, Z_NO_FLUSH);
+
+	*outlen -= gz->zs.avail_out;
+	*in = gz->zs.next_in;
+	*inlen = gz->zs.avail_in;
+
+	switch (rc) {
+	case Z_STREAM_END:
+		return 1;
+	case Z_OK:
+	case Z_BUF_ERROR:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+size_t
+gzip_stream_size(const void *trailer)
+{
+	assert(trailer);
+
+	const unsigned char *p = trailer;
+
+	return (size_t)p[0] | (size_t)p[1] << 8 | (size_t)p[2] << 16 | (size_t)p[3] << 24;
+}
+
+void
+gzip_stream_close(struct gzip *gz)
+{
+	if (gz) {
+		if (gz->deflating)
+			deflateEnd(&gz->zs);
+		else
+			inflateEnd(&gz->zs);
+		free(gz);
+	}
+}
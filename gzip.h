@@ -0,0 +1,91 @@
+/*
+ * gzip.h -- gzip compression of paste bodies
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PASTER_GZIP_H
+#define PASTER_GZIP_H
+
+#include <stddef.h>
+
+struct gzip;
+
+/**
+ * Compress len bytes of data into a newly allocated gzip stream, its size is
+ * stored in outlen.
+ *
+ * Returns NULL on failure.
+ */
+void *
+gzip_compress(const void *data, size_t len, size_t *outlen);
+
+/**
+ * Decompress a gzip stream into a newly allocated buffer, a NUL terminator
+ * is appended but not counted in outlen.
+ *
+ * Returns NULL if the stream is invalid.
+ */
+char *
+gzip_decompress(const void *data, size_t len, size_t *outlen);
+
+/**
+ * Create an incremental decompressor for streams too large to be decoded in
+ * memory at once.
+ *
+ * Returns NULL on failure.
+ */
+struct gzip *
+gzip_stream_open(void);
+
+/**
+ * Decompress as much of the *inlen bytes at *in as fits in the *outlen bytes
+ * of out. On return *in and *inlen describe the input left and *outlen is
+ * set to the number of bytes produced.
+ *
+ * Returns 1 at the end of the stream, 0 if more input or output space is
+ * needed and -1 if the stream is invalid.
+ */
+int
+gzip_stream_inflate(struct gzip *, const void **in, size_t *inlen, void *out, size_t *outlen);
+
+/**
+ * Create an incremental compressor, the whole input must be available but
+ * the output is produced by pieces of the caller's size.
+ *
+ * Returns NULL on failure.
+ */
+struct gzip *
+gzip_stream_deflater(void);
+
+/**
+ * Compress the *inlen bytes at *in into the *outlen bytes of out, like
+ * gzip_stream_inflate. The input given is the end of the data, call again
+ * with the input left until it returns 1.
+ */
+int
+gzip_stream_deflate(struct gzip *, const void **in, size_t *inlen, void *out, size_t *outlen);
+
+/**
+ * Read the uncompressed size from the last 4 bytes of a gzip stream, it is
+ * only exact for data smaller than 4GiB.
+ */
+size_t
+gzip_stream_size(const void *trailer);
+
+void
+gzip_stream_close(struct gzip *);
+
+#endif /* !PASTER_GZIP_H */
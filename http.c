@@ -18,6 +18,7 @@
 
 #include <assert.h>
 
+#include "arena.h"
 #include "database.h"
 #include "http.h"
 #include "log.h"
@@ -84,8 +85,15 @@ http_fcgi_run(void)
 	if (khttp_fcgi_init(&fcgi, NULL, 0, pages, PAGE_LAST, 0) != KCGI_OK)
 		return;
 
-	while (khttp_fcgi_parse(fcgi, &req) == KCGI_OK)
+	while (khttp_fcgi_parse(fcgi, &req) == KCGI_OK) {
 		process(&req);
 
+		/* The page has called khttp_free, nothing points to the arena. */
+		log_debug("http: request used %zu allocations, %zu bytes",
+		    arena.allocs, arena.bytes);
+		arena_reset(&arena);
+	}
+
 	khttp_fcgi_free(fcgi);
+	arena_finish(&arena);
 }
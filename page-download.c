@@ -17,32 +17,90 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
+#include "arena.h"
 #include "database.h"
 #include "page-status.h"
 #include "page.h"
 #include "paste.h"
 
+/*
+ * Tell if the client listed the given content coding in Accept-Encoding
+ * without refusing it with a zero quality value.
+ */
+static int
+accepts(const struct kreq *req, const char *coding)
+{
+	const struct khead *head = req->reqmap[KREQU_ACCEPT_ENCODING];
+	const size_t len = strlen(coding);
+	const char *p, *param;
+
+	if (!head)
+		return 0;
+
+	for (p = head->val; *p; p += strcspn(p, ",")) {
+		p += strspn(p, ", \t");
+
+		if (strcspn(p, ",; \t") != len || strncasecmp(p, coding, len) != 0)
+			continue;
+
+		/* Parameters up to the next coding, only the quality matters. */
+		for (param = p + len; *param && *param != ','; param += strcspn(param, ";,")) {
+			param += strspn(param, "; \t");
+
+			if ((*param == 'q' || *param == 'Q') && param[1] == '=')
+				return strtod(param + 2, NULL) > 0;
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
 static void
 get(struct kreq *req)
 {
-	struct paste paste;
+	struct paste paste = { .arena = &arena };
+	struct database_stream stream;
+	enum paste_encoding accept = PASTE_ENCODING_IDENTITY;
+	char buf[DATABASE_STREAM_CHUNK];
+	long long int n;
 
-	if (database_get(&database, &paste, req->path) < 0)
+	if (accepts(req, "gzip"))
+		accept = PASTE_ENCODING_GZIP;
+
+	if (database_stream_open(&database, &stream, &paste, req->path, accept) < 0)
 		page_status(req, KHTTP_404);
 	else {
 		khttp_head(req, kresps[KRESP_CONTENT_TYPE], "%s", kmimetypes[KMIME_APP_OCTET_STREAM]);
-#if 0
-		/* TODO: this seems to generated truncated files. */
-		khttp_head(req, kresps[KRESP_CONTENT_LENGTH], "%zu", strlen(paste.code));
-#endif
+
+		/* Stored compressed, send as is. */
+		if (paste.encoding == PASTE_ENCODING_GZIP) {
+			khttp_head(req, kresps[KRESP_CONTENT_ENCODING], "gzip");
+			khttp_head(req, kresps[KRESP_VARY], "Accept-Encoding");
+		}
+
+		khttp_head(req, kresps[KRESP_CONTENT_LENGTH], "%zu", paste.codesz);
 		khttp_head(req, kresps[KRESP_CONNECTION], "keep-alive");
 		khttp_head(req, kresps[KRESP_CONTENT_DISPOSITION], "attachment; filename=\"%s.%s\"",
 			paste.id, paste.language
 		);
-		khttp_body(req);
-		khttp_puts(req, paste.code);
+
+		/*
+		 * Never let kcgi compress the body on its own, the announced
+		 * length would not match what is written anymore.
+		 */
+		khttp_body_compress(req, 0);
+
+		while ((n = database_stream_read(&stream, buf, sizeof (buf))) > 0)
+			khttp_write(req, buf, n);
+
 		khttp_free(req);
+		database_stream_close(&stream);
 		paste_finish(&paste);
 	}
 }
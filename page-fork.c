@@ -18,6 +18,7 @@
 
 #include <assert.h>
 
+#include "arena.h"
 #include "database.h"
 #include "page-new.h"
 #include "page-status.h"
@@ -27,7 +28,7 @@
 static void
 get(struct kreq *req)
 {
-	struct paste paste;
+	struct paste paste = { .arena = &arena };
 
 	if (database_get(&database, &paste, req->path) < 0)
 		page_status(req, KHTTP_404);
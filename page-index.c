@@ -17,6 +17,8 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "database.h"
 #include "page-index.h"
@@ -27,68 +29,178 @@
 
 #define TITLE   "paster -- recent pastes"
 #define HTML    "index.html"
-#define LIMIT   16
+#define LIMIT   DATABASE_RECENTS
 
 struct page {
 	struct kreq *req;
 	struct ktemplate template;
-	const struct paste *pastes;
-	const size_t pastesz;
+	const struct paste *pastes;     /* Listing already in memory or */
+	size_t pastesz;
+	struct database_cursor *cursor; /* rows read while rendering. */
+	size_t limit;                   /* Rows of a full page. */
+	size_t rendered;
+	const char *next;
+	time_t last;                    /* Key of the last row rendered. */
+	char lastid[32];
 };
 
 enum {
-	KEYWORD_PASTES
+	KEYWORD_PASTES,
+	KEYWORD_NEXT
 };
 
 static const char * const keywords[] = {
-	[KEYWORD_PASTES] = "pastes"
+	[KEYWORD_PASTES] = "pastes",
+	[KEYWORD_NEXT]   = "next"
 };
 
-static int
-format(size_t keyword, void *data)
+/*
+ * Full text search excerpts have their matches delimited by STX and ETX
+ * characters, render them as highlighted text.
+ *
+ * Pasted code may contain these characters too, a marker which does not
+ * open or close a highlight is dropped so that the elements always pair up.
+ */
+static void
+snippet(struct khtmlreq *html, const struct database_text *text)
 {
-	struct page *page = data;
-	struct khtmlreq html;
-	const struct paste *paste;
+	const char *p = text->data, *end = text->data + text->len;
+	size_t n;
+	int marked = 0;
 
-	khtml_open(&html, page->req, KHTML_PRETTY);
+	khtml_elem(html, KELEM_TR);
+	khtml_attr(html, KELEM_TD, KATTR_COLSPAN, "5", KATTR_CLASS, "snippet", KATTR__MAX);
+	khtml_elem(html, KELEM_CODE);
 
-	switch (keyword) {
-	case KEYWORD_PASTES:
-		for (size_t i = 0; i < page->pastesz; ++i) {
-			paste = &page->pastes[i];
+	while (p < end) {
+		if (*p == '\2') {
+			if (!marked)
+				khtml_elem(html, KELEM_MARK);
 
-			khtml_elem(&html, KELEM_TR);
+			marked = 1;
+			p++;
+		} else if (*p == '\3') {
+			if (marked)
+				khtml_closeelem(html, 1);
 
-			/* link */
-			khtml_elem(&html, KELEM_TD);
-			khtml_attr(&html, KELEM_A,
-			    KATTR_HREF, bprintf("/paste/%s", paste->id), KATTR__MAX);
-			khtml_printf(&html, paste->title);
-			khtml_closeelem(&html, 1);
+			marked = 0;
+			p++;
+		} else {
+			for (n = 0; p + n < end && p[n] != '\2' && p[n] != '\3'; ++n)
+				continue;
 
-			/* author */
-			khtml_elem(&html, KELEM_TD);
-			khtml_puts(&html, paste->author);
-			khtml_closeelem(&html, 1);
+			khtml_write(p, n, html);
+			p += n;
+		}
+	}
 
-			/* language */
-			khtml_elem(&html, KELEM_TD);
-			khtml_puts(&html, paste->language);
-			khtml_closeelem(&html, 1);
+	khtml_closeelem(html, 3 + marked);
+}
 
-			/* date */
-			khtml_elem(&html, KELEM_TD);
-			khtml_puts(&html, bstrftime("%F %T", localtime(&paste->timestamp)));
-			khtml_closeelem(&html, 1);
+/*
+ * Rows of listings kept in memory are rendered the same way, their texts
+ * are borrowed from the pastes.
+ */
+static void
+borrow(const struct paste *paste, struct database_row *row)
+{
+	memset(row, 0, sizeof (*row));
+	row->id.data = paste->id;
+	row->id.len = strlen(paste->id);
+	row->title.data = paste->title;
+	row->title.len = strlen(paste->title);
+	row->author.data = paste->author;
+	row->author.len = strlen(paste->author);
+	row->language.data = paste->language;
+	row->language.len = strlen(paste->language);
+	row->timestamp = paste->timestamp;
+	row->visible = paste->visible;
+	row->duration = paste->duration;
 
-			/* expiration */
-			khtml_elem(&html, KELEM_TD);
-			khtml_puts(&html, ttl(paste->timestamp, paste->duration));
-			khtml_closeelem(&html, 1);
+	if (paste->snippet) {
+		row->snippet.data = paste->snippet;
+		row->snippet.len = strlen(paste->snippet);
+	}
+}
 
-			khtml_closeelem(&html, 1);
+static void
+render(struct page *page, struct khtmlreq *html, const struct database_row *row)
+{
+	const time_t timestamp = row->timestamp;
+
+	khtml_elem(html, KELEM_TR);
+
+	/* link */
+	khtml_elem(html, KELEM_TD);
+	khtml_attr(html, KELEM_A, KATTR_HREF,
+	    bprintf("/paste/%.*s", (int)row->id.len, row->id.data), KATTR__MAX);
+	khtml_write(row->title.data, row->title.len, html);
+	khtml_closeelem(html, 1);
+
+	/* author */
+	khtml_elem(html, KELEM_TD);
+	khtml_write(row->author.data, row->author.len, html);
+	khtml_closeelem(html, 1);
+
+	/* language */
+	khtml_elem(html, KELEM_TD);
+	khtml_write(row->language.data, row->language.len, html);
+	khtml_closeelem(html, 1);
+
+	/* date */
+	khtml_elem(html, KELEM_TD);
+	khtml_puts(html, bstrftime("%F %T", localtime(&timestamp)));
+	khtml_closeelem(html, 1);
+
+	/* expiration */
+	khtml_elem(html, KELEM_TD);
+	khtml_puts(html, ttl(row->timestamp, row->duration));
+	khtml_closeelem(html, 1);
+
+	khtml_closeelem(html, 1);
+
+	if (row->snippet.data)
+		snippet(html, &row->snippet);
+
+	/* The row is gone after this one, keep its key for the next link. */
+	page->rendered++;
+	page->last = row->timestamp;
+	page->lastid[0] = '\0';
+
+	if (row->id.len < sizeof (page->lastid)) {
+		memcpy(page->lastid, row->id.data, row->id.len);
+		page->lastid[row->id.len] = '\0';
+	}
+}
+
+static int
+format(size_t keyword, void *data)
+{
+	struct page *page = data;
+	struct khtmlreq html;
+	struct database_row row;
+
+	khtml_open(&html, page->req, KHTML_PRETTY);
 
+	switch (keyword) {
+	case KEYWORD_PASTES:
+		if (!page->cursor) {
+			for (size_t i = 0; i < page->pastesz; ++i) {
+				borrow(&page->pastes[i], &row);
+				render(page, &html, &row);
+			}
+		} else {
+			while (database_cursor_next(page->cursor) > 0)
+				render(page, &html, &page->cursor->row);
+		}
+		break;
+	case KEYWORD_NEXT:
+		/* Only full pages may have a following one. */
+		if (page->next && page->rendered && page->rendered == page->limit && page->lastid[0]) {
+			khtml_attr(&html, KELEM_A, KATTR_HREF, bprintf("%safter=%lld-%s",
+			    page->next, (long long int)page->last, page->lastid), KATTR__MAX);
+			khtml_puts(&html, "Older pastes");
+			khtml_closeelem(&html, 1);
 		}
 		break;
 	default:
@@ -103,38 +215,105 @@ format(size_t keyword, void *data)
 static void
 get(struct kreq *req)
 {
-	struct paste pastes[LIMIT];
-	size_t pastesz = NELEM(pastes);
+	const struct database_recents *recents;
+	const struct paste *after;
+	struct database_cursor cursor;
+	struct paste key;
 
-	if (database_recents(&database, pastes, &pastesz) < 0)
+	/* The first page is by far the most requested, render it from memory. */
+	if (!(after = page_index_after(req, &key))) {
+		if (!(recents = database_recents_snapshot(&database)))
+			page_status(req, KHTTP_500);
+		else
+			page_index_render(req, recents->pastes, recents->pastesz,
+			    recents->pastesz == LIMIT ? "/?" : NULL);
+
+		return;
+	}
+
+	if (database_cursor_recents(&database, &cursor, LIMIT, after) < 0)
 		page_status(req, KHTTP_500);
 	else {
-		page_index_render(req, pastes, pastesz);
-
-		for (size_t i = 0; i < pastesz; ++i)
-			paste_finish(&pastes[i]);
+		page_index_stream(req, &cursor, "/?");
+		database_cursor_finish(&cursor);
 	}
 }
 
+const struct paste *
+page_index_after(const struct kreq *req, struct paste *key)
+{
+	assert(req);
+	assert(key);
+
+	const char *val = NULL;
+	char *end;
+
+	for (size_t i = 0; i < req->fieldsz; ++i)
+		if (strcmp(req->fields[i].key, "after") == 0)
+			val = req->fields[i].val;
+
+	if (!val)
+		return NULL;
+
+	/* after=<date>-<id>, identifiers never contain a dash. */
+	memset(key, 0, sizeof (*key));
+	key->timestamp = strtoll(val, &end, 10);
+
+	if (end == val || *end++ != '-' || !*end)
+		return NULL;
+
+	key->id = end;
+
+	return key;
+}
+
+static void
+show(struct page *self)
+{
+	self->template = (struct ktemplate) {
+		.cb = format,
+		.arg = self,
+		.key = keywords,
+		.keysz = NELEM(keywords)
+	};
+
+	page(self->req, KHTTP_200, TITLE, HTML, &self->template);
+}
+
 void
-page_index_render(struct kreq *req, const struct paste *pastes, size_t pastesz)
+page_index_render(struct kreq *req,
+                  const struct paste *pastes,
+                  size_t pastesz,
+                  const char *next)
 {
 	assert(req);
 	assert(pastes);
 
 	struct page self = {
 		.req = req,
-		.template = {
-			.cb = format,
-			.arg = &self,
-			.key = keywords,
-			.keysz = NELEM(keywords)
-		},
 		.pastes = pastes,
-		.pastesz = pastesz
+		.pastesz = pastesz,
+		.limit = pastesz,
+		.next = next
+	};
+
+	show(&self);
+}
+
+void
+page_index_stream(struct kreq *req, struct database_cursor *cursor, const char *next)
+{
+	assert(req);
+	assert(cursor);
+
+	struct page self = {
+		.req = req,
+		.cursor = cursor,
+		.limit = cursor->max,
+		.next = next
 	};
 
-	page(req, KHTTP_200, TITLE, HTML, &self.template);
+	show(&self);
 }
 
 void
@@ -21,13 +21,36 @@
 
 #include <stddef.h>
 
+struct database_cursor;
 struct kreq;
 struct paste;
 
+/**
+ * Parse the after=<date>-<id> pagination field into key, the id field
+ * borrows the request value so key must not be finished.
+ *
+ * Return key or NULL if the field is absent or invalid.
+ */
+const struct paste *
+page_index_after(const struct kreq *req, struct paste *key);
+
+/**
+ * Render the listing of pastes, if next is not NULL it is the URL prefix of
+ * the following page which the after field is appended to.
+ */
 void
 page_index_render(struct kreq *req,
                   const struct paste *pastes,
-                  size_t pastesz);
+                  size_t pastesz,
+                  const char *next);
+
+/**
+ * Like page_index_render with rows read from the cursor while the page is
+ * written, the link to the next page is only shown if the cursor gave its
+ * maximum number of rows. The cursor is left open.
+ */
+void
+page_index_stream(struct kreq *req, struct database_cursor *cursor, const char *next);
 
 void
 page_index(struct kreq *);
@@ -17,9 +17,12 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "config.h"
 #include "database.h"
 #include "page-new.h"
 #include "page-status.h"
@@ -124,10 +127,11 @@ static void
 post(struct kreq *req)
 {
 	struct paste paste;
-	const char *key, *val, *scheme;
+	const char *key, *val, *scheme, *code = "";
+	size_t codesz = 0;
 	int raw = 0;
 
-	paste_init(&paste);
+	paste_init_arena(&paste, &arena);
 
 	// TODO: add verification support.
 	for (size_t i = 0; i < req->fieldsz; ++i) {
@@ -135,22 +139,35 @@ post(struct kreq *req)
 		val = req->fields[i].val;
 
 		if (strcmp(key, "title") == 0 && strlen(val))
-			replace(&paste.title, val);
+			replace(paste.arena, &paste.title, val);
 		else if (strcmp(key, "author") == 0 && strlen(val))
-			replace(&paste.author, val);
+			replace(paste.arena, &paste.author, val);
 		else if (strcmp(key, "language") == 0)
-			replace(&paste.language, val);
+			replace(paste.arena, &paste.language, val);
 		else if (strcmp(key, "duration") == 0)
 			paste.duration = duration(val);
-		else if (strcmp(key, "code") == 0)
-			replace(&paste.code, val);
+		else if (strcmp(key, "code") == 0) {
+			/* Written from kcgi's buffer, see database_insert_code. */
+			code = val;
+			codesz = req->fields[i].valsz;
+
+			/* Trim leading spaces like replace does. */
+			while (codesz && isspace((unsigned char)*code)) {
+				code++;
+				codesz--;
+			}
+		}
 		else if (strcmp(key, "visible") == 0)
 			paste.visible = strcmp(val, "on") == 0;
 		else if (strcmp(key, "raw") == 0)
 			raw = strcmp(val, "on") == 0;
 	}
 
-	if (database_insert(&database, &paste) < 0)
+	if (!codesz)
+		page_status(req, KHTTP_400);
+	else if (config.maxsize && codesz > config.maxsize)
+		page_status(req, KHTTP_413);
+	else if (database_insert_code(&database, &paste, code, codesz) < 0)
 		page_status(req, KHTTP_500);
 	else {
 		scheme = req->scheme == KSCHEME_HTTP ? "http" : "https";
@@ -18,6 +18,7 @@
 
 #include <assert.h>
 
+#include "arena.h"
 #include "database.h"
 #include "page-paste.h"
 #include "page-status.h"
@@ -108,6 +109,9 @@ get(struct kreq *req)
 			.arg = &self,
 			.key = keywords,
 			.keysz = NELEM(keywords)
+		},
+		.paste = {
+			.arena = &arena
 		}
 	};
 
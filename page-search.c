@@ -17,6 +17,8 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "database.h"
@@ -69,28 +71,38 @@ format(size_t keyword, void *data)
 	return 1;
 }
 
-static void
-get(struct kreq *req)
+/*
+ * URL prefix of the next page of results, keeping the search criteria.
+ */
+static char *
+next(const char *title, const char *author, const char *language)
 {
-	struct page self = {
-		.req = req,
-		.template = {
-			.cb = format,
-			.arg = &self,
-			.key = keywords,
-			.keysz = NELEM(keywords)
-		}
-	};
+	char *etitle, *eauthor, *elanguage, *ret;
 
-	page(req, KHTTP_200, TITLE, HTML, &self.template);
+	etitle    = khttp_urlencode(title    ? title    : "");
+	eauthor   = khttp_urlencode(author   ? author   : "");
+	elanguage = khttp_urlencode(language ? language : "");
+
+	if (!etitle || !eauthor || !elanguage)
+		die("abort: %s\n", strerror(ENOMEM));
+
+	ret = estrdup(bprintf("/search?title=%s&author=%s&language=%s&",
+	    etitle, eauthor, elanguage));
+
+	free(etitle);
+	free(eauthor);
+	free(elanguage);
+
+	return ret;
 }
 
 static void
-post(struct kreq *req)
+search(struct kreq *req)
 {
-	struct paste pastes[LIMIT];
-	size_t pastesz = NELEM(pastes);
-	const char *key, *val, *title = NULL, *author = NULL, *language = NULL;
+	struct database_cursor cursor;
+	struct paste after;
+	const char *key, *val, *title = NULL, *author = NULL, *language = NULL, *query = NULL;
+	char *link = NULL;
 
 	for (size_t i = 0; i < req->fieldsz; ++i) {
 		key = req->fields[i].key;
@@ -102,6 +114,8 @@ post(struct kreq *req)
 			author = val;
 		else if (strcmp(key, "language") == 0)
 			language = val;
+		else if (strcmp(key, "query") == 0)
+			query = val;
 	}
 
 	/* Sets to null if they are empty. */
@@ -109,17 +123,41 @@ post(struct kreq *req)
 		title = NULL;
 	if (author && strlen(author) == 0)
 		author = NULL;
+	if (language && strlen(language) == 0)
+		language = NULL;
+	if (query && strlen(query) == 0)
+		query = NULL;
 
-	if (database_search(&database, pastes, &pastesz, title, author, language) < 0)
+	if (database_cursor_search(&database, &cursor, LIMIT, title, author, language, query,
+	    page_index_after(req, &after)) < 0)
 		page_status(req, KHTTP_500);
 	else {
-		page_index_render(req, pastes, pastesz);
+		/* Results on words are ranked by relevance, not paginated. */
+		if (!query)
+			link = next(title, author, language);
 
-		for (size_t i = 0; i < pastesz; ++i)
-			paste_finish(&pastes[i]);
+		page_index_stream(req, &cursor, link);
+		database_cursor_finish(&cursor);
+		free(link);
 	}
 }
 
+static void
+get(struct kreq *req)
+{
+	struct page self = {
+		.req = req,
+		.template = {
+			.cb = format,
+			.arg = &self,
+			.key = keywords,
+			.keysz = NELEM(keywords)
+		}
+	};
+
+	page(req, KHTTP_200, TITLE, HTML, &self.template);
+}
+
 void
 page_search(struct kreq *req)
 {
@@ -127,10 +165,14 @@ page_search(struct kreq *req)
 
 	switch (req->method) {
 	case KMETHOD_GET:
-		get(req);
+		/* Following pages of results are plain links. */
+		if (req->fieldsz)
+			search(req);
+		else
+			get(req);
 		break;
 	case KMETHOD_POST:
-		post(req);
+		search(req);
 		break;
 	default:
 		page_status(req, KHTTP_400);
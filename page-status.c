@@ -39,6 +39,7 @@ static const int status_codes[] = {
 	[KHTTP_200]             = 200,
 	[KHTTP_400]             = 400,
 	[KHTTP_404]             = 404,
+	[KHTTP_413]             = 413,
 	[KHTTP_500]             = 500
 };
 
@@ -46,6 +47,7 @@ static const char * const status_messages[] = {
 	[KHTTP_200]             = "OK",
 	[KHTTP_400]             = "Bad Request",
 	[KHTTP_404]             = "Not Found",
+	[KHTTP_413]             = "Payload Too Large",
 	[KHTTP_500]             = "Internal Server Error"
 };
 
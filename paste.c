@@ -17,12 +17,86 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "arena.h"
 #include "paste.h"
+#include "sha256.h"
 #include "util.h"
 
+/*
+ * Code of pastes sharing it, it is never modified once shared.
+ */
+struct paste_body {
+	char *code;
+	unsigned long long refs;        /* Pastes using it. */
+};
+
+/*
+ * Per-process generator: each block is the SHA-256 of a secret key and a
+ * counter. The key comes from getentropy(3), which is getrandom(2) on Linux,
+ * and is drawn again in a forked process so that workers never share a
+ * stream.
+ */
+static struct {
+	unsigned char key[SHA256_DIGEST_LENGTH];
+	unsigned char block[SHA256_DIGEST_LENGTH];
+	size_t blocksz;                 /* Bytes left in block. */
+	uint64_t counter;
+	pid_t pid;
+} rng;
+
+static void
+seed(void)
+{
+	if (getentropy(rng.key, sizeof (rng.key)) < 0)
+		die("abort: getentropy: %s", strerror(errno));
+
+	rng.blocksz = 0;
+	rng.counter = 0;
+	rng.pid = getpid();
+}
+
+static unsigned char
+random_byte(void)
+{
+	struct sha256 ctx;
+
+	if (rng.pid != getpid())
+		seed();
+
+	if (rng.blocksz == 0) {
+		sha256_init(&ctx);
+		sha256_update(&ctx, rng.key, sizeof (rng.key));
+		sha256_update(&ctx, &rng.counter, sizeof (rng.counter));
+		sha256_final(&ctx, rng.block);
+		rng.blocksz = sizeof (rng.block);
+		rng.counter++;
+	}
+
+	return rng.block[--rng.blocksz];
+}
+
+/*
+ * Uniform value lower than n, bytes above the largest multiple of n are
+ * drawn again.
+ */
+static unsigned int
+random_uniform(unsigned int n)
+{
+	const unsigned int limit = 256 - 256 % n;
+	unsigned int b;
+
+	while ((b = random_byte()) >= limit)
+		continue;
+
+	return b % n;
+}
+
 void
 paste_init(struct paste *paste)
 {
@@ -36,15 +110,111 @@ paste_init(struct paste *paste)
 	paste->duration = PASTE_DURATION_DAY;
 }
 
+void
+paste_init_arena(struct paste *paste, struct arena *owner)
+{
+	assert(paste);
+	assert(owner);
+
+	memset(paste, 0, sizeof (*paste));
+	paste->arena = owner;
+	paste->title = arena_strdup(owner, PASTE_DEFAULT_TITLE);
+	paste->author = arena_strdup(owner, PASTE_DEFAULT_AUTHOR);
+	paste->language = arena_strdup(owner, PASTE_DEFAULT_LANGUAGE);
+	paste->timestamp = time(NULL);
+	paste->duration = PASTE_DURATION_DAY;
+}
+
+void
+paste_reset(struct paste *paste)
+{
+	assert(paste);
+
+	struct arena *owner = paste->arena;
+
+	memset(paste, 0, sizeof (*paste));
+	paste->arena = owner;
+}
+
+char *
+paste_text(const struct paste *paste, const char *s, size_t len)
+{
+	assert(paste);
+	assert(s || len == 0);
+
+	char *ret;
+
+	if (paste->arena)
+		return arena_strndup(paste->arena, s, len);
+
+	ret = ecalloc(1, len + 1);
+
+	if (len)
+		memcpy(ret, s, len);
+
+	return ret;
+}
+
+void
+paste_share_code(struct paste *dst, struct paste *src)
+{
+	assert(dst);
+	assert(src);
+
+	if (!src->body) {
+		src->body = ecalloc(1, sizeof (*src->body));
+		src->body->code = src->code;
+		src->body->refs = 1;
+	}
+
+	dst->body = src->body;
+	dst->body->refs++;
+	dst->code = src->code;
+	dst->codesz = src->codesz;
+	dst->encoding = src->encoding;
+}
+
+/*
+ * 12 characters over 36 symbols gives 62 bits so storage engines only need
+ * to check for a collision.
+ */
+void
+paste_create_id(struct paste *paste)
+{
+	assert(paste);
+
+	static const char table[] = "abcdefghijklmnopqrstuvwxyz1234567890";
+	char id[13] = {0};
+
+	for (size_t i = 0; i < sizeof (id) - 1; ++i)
+		id[i] = table[random_uniform(sizeof (table) - 1)];
+
+	if (!paste->arena)
+		free(paste->id);
+
+	paste->id = paste_text(paste, id, sizeof (id) - 1);
+}
+
 void
 paste_finish(struct paste *paste)
 {
 	assert(paste);
 
-	free(paste->id);
-	free(paste->title);
-	free(paste->author);
-	free(paste->language);
-	free(paste->code);
+	/* The code may be large, it always comes from the heap. */
+	if (!paste->arena) {
+		free(paste->id);
+		free(paste->title);
+		free(paste->author);
+		free(paste->language);
+		free(paste->snippet);
+	}
+
+	if (!paste->body)
+		free(paste->code);
+	else if (--paste->body->refs == 0) {
+		free(paste->body->code);
+		free(paste->body);
+	}
+
 	memset(paste, 0, sizeof (struct paste));
 }
@@ -19,8 +19,12 @@
 #ifndef PASTER_PASTE_H
 #define PASTER_PASTE_H
 
+#include <stddef.h>
 #include <time.h>
 
+struct arena;
+struct paste_body;
+
 #define PASTE_DURATION_HOUR      3600           /* Seconds in one hour. */
 #define PASTE_DURATION_DAY       86400          /* Seconds in one day. */
 #define PASTE_DURATION_WEEK      604800         /* Seconds in one week. */
@@ -30,20 +34,63 @@
 #define PASTE_DEFAULT_AUTHOR     "Anonymous"
 #define PASTE_DEFAULT_LANGUAGE   "nohighlight"
 
+enum paste_encoding {
+	PASTE_ENCODING_IDENTITY,        /* Plain text. */
+	PASTE_ENCODING_GZIP             /* Compressed with gzip. */
+};
+
 struct paste {
 	char *id;
 	char *title;
 	char *author;
 	char *language;
 	char *code;
+	size_t codesz;                  /* Length of code, set by database_get. */
+	enum paste_encoding encoding;   /* Encoding of code. */
+	char *snippet;                  /* Excerpt from a full text search. */
 	time_t timestamp;
 	int visible;
 	int duration;
+	struct arena *arena;            /* Owner of the strings but code or NULL. */
+	struct paste_body *body;        /* Holder of code if shared or NULL. */
 };
 
 void
 paste_init(struct paste *paste);
 
+/**
+ * Like paste_init with the strings but code allocated from the arena,
+ * paste_finish then only frees the code.
+ */
+void
+paste_init_arena(struct paste *paste, struct arena *owner);
+
+/**
+ * Zero every field but the arena, before the paste is filled again.
+ */
+void
+paste_reset(struct paste *paste);
+
+/**
+ * Copy len bytes of s NUL terminated for a string field of the paste, from
+ * its arena if it has one.
+ */
+char *
+paste_text(const struct paste *paste, const char *s, size_t len);
+
+/**
+ * Let dst use the code of src without copying it, it is freed with the last
+ * paste using it. Shared code must not be modified.
+ */
+void
+paste_share_code(struct paste *dst, struct paste *src);
+
+/**
+ * Replace the paste identifier with a new random one.
+ */
+void
+paste_create_id(struct paste *paste);
+
 void
 paste_finish(struct paste *paste);
 
@@ -37,6 +37,12 @@
  */
 #define CLEANUP_INTERVAL 3600
 
+/*
+ * Maximum number of free pages returned to the file system at each cleanup,
+ * to keep the write lock short. Leftovers are reclaimed by the next ones.
+ */
+#define CLEANUP_PAGES 4096
+
 static pthread_t thread;
 static sig_atomic_t running = 1;
 
@@ -59,8 +65,9 @@ cleanup(void *data)
 	for (;;) {
 		sleep(CLEANUP_INTERVAL);
 
-		if (database_open(&db, config.databasepath) == 0) {
+		if (database_open_maintenance(&db, config.databasepath) == 0) {
 			database_clear(&db);
+			database_vacuum(&db, CLEANUP_PAGES);
 			database_finish(&db);
 		}
 	}
@@ -99,7 +106,6 @@ init(void)
 	if (pthread_create(&thread, NULL, cleanup, NULL) < 0)
 		die("abort: pthread_create: %s", strerror(errno));
 
-	srand(time(NULL));
 	log_open();
 
 	if (!config.databasepath[0])
@@ -125,7 +131,11 @@ finish(void)
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: paster [-qv] [-d database-path] [-t theme-directory]\n");
+	fprintf(stderr, "usage: paster [-qv] [-b database-bucket] [-c clear-rows] [-C clear-time]\n");
+	fprintf(stderr, "              [-d database-path] [-e database-engine] [-k cache-size]\n");
+	fprintf(stderr, "              [-m max-size] [-p database-profile] [-s database-shards]\n");
+	fprintf(stderr, "              [-t theme-directory] [-w commit-window] [-W commit-rows]\n");
+	fprintf(stderr, "              [-z compression-threshold]\n");
 	exit(1);
 }
 
@@ -140,22 +150,77 @@ main(int argc, char **argv)
 	/* Seek environment variables before options. */
 	if ((value = getenv("PASTERD_DATABASE_PATH")))
 		snprintf(config.databasepath, sizeof (config.databasepath), "%s", value);
+	if ((value = getenv("PASTERD_DATABASE_PROFILE")))
+		snprintf(config.databaseprofile, sizeof (config.databaseprofile), "%s", value);
+	if ((value = getenv("PASTERD_DATABASE_ENGINE")))
+		snprintf(config.databaseengine, sizeof (config.databaseengine), "%s", value);
+	if ((value = getenv("PASTERD_DATABASE_SHARDS")))
+		config.databaseshards = strtoull(value, NULL, 10);
+	if ((value = getenv("PASTERD_DATABASE_BUCKET")))
+		config.databasebucket = strtoul(value, NULL, 10);
 	if ((value = getenv("PASTERD_THEME_DIR")))
 		snprintf(config.themedir, sizeof (config.themedir), "%s", value);
 	if ((value = getenv("PASTERD_VERBOSITY")))
 		config.verbosity = atoi(value);
-
-	while ((opt = getopt(argc, argv, "d:t:qv")) != -1) {
+	if ((value = getenv("PASTERD_COMPRESSION")))
+		config.compression = strtoull(value, NULL, 10);
+	if ((value = getenv("PASTERD_CACHE_SIZE")))
+		config.cachesize = strtoull(value, NULL, 10);
+	if ((value = getenv("PASTERD_MAX_SIZE")))
+		config.maxsize = strtoull(value, NULL, 10);
+	if ((value = getenv("PASTERD_CLEAR_ROWS")))
+		config.clearrows = strtoull(value, NULL, 10);
+	if ((value = getenv("PASTERD_CLEAR_TIME")))
+		config.cleartime = strtoul(value, NULL, 10);
+	if ((value = getenv("PASTERD_COMMIT_WINDOW")))
+		config.commitwindow = strtoul(value, NULL, 10);
+	if ((value = getenv("PASTERD_COMMIT_ROWS")))
+		config.commitrows = strtoull(value, NULL, 10);
+
+	while ((opt = getopt(argc, argv, "b:c:C:d:e:k:m:p:s:t:w:W:z:qv")) != -1) {
 		switch (opt) {
+		case 'b':
+			config.databasebucket = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			config.clearrows = strtoull(optarg, NULL, 10);
+			break;
+		case 'C':
+			config.cleartime = strtoul(optarg, NULL, 10);
+			break;
 		case 'd':
 			snprintf(config.databasepath, sizeof (config.databasepath), "%s", optarg);
 			break;
+		case 'e':
+			snprintf(config.databaseengine, sizeof (config.databaseengine), "%s", optarg);
+			break;
+		case 'k':
+			config.cachesize = strtoull(optarg, NULL, 10);
+			break;
+		case 'm':
+			config.maxsize = strtoull(optarg, NULL, 10);
+			break;
+		case 'p':
+			snprintf(config.databaseprofile, sizeof (config.databaseprofile), "%s", optarg);
+			break;
+		case 's':
+			config.databaseshards = strtoull(optarg, NULL, 10);
+			break;
 		case 't':
 			snprintf(config.themedir, sizeof (config.themedir), "%s", optarg);
 			break;
 		case 'v':
 			config.verbosity++;
 			break;
+		case 'w':
+			config.commitwindow = strtoul(optarg, NULL, 10);
+			break;
+		case 'W':
+			config.commitrows = strtoull(optarg, NULL, 10);
+			break;
+		case 'z':
+			config.compression = strtoull(optarg, NULL, 10);
+			break;
 		case 'q':
 			config.verbosity = 0;
 			break;
@@ -0,0 +1,169 @@
+/*
+ * sha256.c -- SHA-256 message digest
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sha256.h"
+
+#define ROR(x, n)       (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)     (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)    (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define S0(x)           (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x)           (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define G0(x)           (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define G1(x)           (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+static const uint32_t k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void
+transform(struct sha256 *ctx, const unsigned char *block)
+{
+	uint32_t w[64], s[8], t1, t2;
+
+	for (int i = 0; i < 16; ++i)
+		w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+		       (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+	for (int i = 16; i < 64; ++i)
+		w[i] = G1(w[i - 2]) + w[i - 7] + G0(w[i - 15]) + w[i - 16];
+
+	memcpy(s, ctx->state, sizeof (s));
+
+	for (int i = 0; i < 64; ++i) {
+		t1 = s[7] + S1(s[4]) + CH(s[4], s[5], s[6]) + k[i] + w[i];
+		t2 = S0(s[0]) + MAJ(s[0], s[1], s[2]);
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = s[3] + t1;
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = t1 + t2;
+	}
+
+	for (int i = 0; i < 8; ++i)
+		ctx->state[i] += s[i];
+}
+
+void
+sha256_init(struct sha256 *ctx)
+{
+	assert(ctx);
+
+	static const uint32_t init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memset(ctx, 0, sizeof (*ctx));
+	memcpy(ctx->state, init, sizeof (init));
+}
+
+void
+sha256_update(struct sha256 *ctx, const void *data, size_t len)
+{
+	assert(ctx);
+	assert(data || len == 0);
+
+	const unsigned char *p = data;
+	size_t n;
+
+	ctx->length += len;
+
+	while (len) {
+		n = sizeof (ctx->block) - ctx->blocksz;
+		n = n < len ? n : len;
+
+		memcpy(ctx->block + ctx->blocksz, p, n);
+		ctx->blocksz += n;
+		p += n;
+		len -= n;
+
+		if (ctx->blocksz == sizeof (ctx->block)) {
+			transform(ctx, ctx->block);
+			ctx->blocksz = 0;
+		}
+	}
+}
+
+void
+sha256_final(struct sha256 *ctx, unsigned char digest[SHA256_DIGEST_LENGTH])
+{
+	assert(ctx);
+	assert(digest);
+
+	const uint64_t bits = ctx->length * 8;
+
+	/* Append the 1 bit, pad with zeroes and end with the length in bits. */
+	ctx->block[ctx->blocksz++] = 0x80;
+
+	if (ctx->blocksz > 56) {
+		memset(ctx->block + ctx->blocksz, 0, sizeof (ctx->block) - ctx->blocksz);
+		transform(ctx, ctx->block);
+		ctx->blocksz = 0;
+	}
+
+	memset(ctx->block + ctx->blocksz, 0, 56 - ctx->blocksz);
+
+	for (int i = 0; i < 8; ++i)
+		ctx->block[56 + i] = bits >> (56 - i * 8);
+
+	transform(ctx, ctx->block);
+
+	for (int i = 0; i < 8; ++i) {
+		digest[i * 4] = ctx->state[i] >> 24;
+		digest[i * 4 + 1] = ctx->state[i] >> 16;
+		digest[i * 4 + 2] = ctx->state[i] >> 8;
+		digest[i * 4 + 3] = ctx->state[i];
+	}
+}
+
+void
+sha256_hex(const void *data, size_t len, char hex[SHA256_HEX_LENGTH])
+{
+	assert(hex);
+
+	struct sha256 ctx;
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+
+	sha256_init(&ctx);
+	sha256_update(&ctx, data, len);
+	sha256_final(&ctx, digest);
+
+	for (size_t i = 0; i < sizeof (digest); ++i)
+		sprintf(&hex[i * 2], "%02x", digest[i]);
+}
@@ -0,0 +1,51 @@
+/*
+ * sha256.h -- SHA-256 message digest
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PASTER_SHA256_H
+#define PASTER_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LENGTH    32
+#define SHA256_HEX_LENGTH       65      /* Including NUL terminator. */
+
+struct sha256 {
+	uint32_t state[8];
+	uint64_t length;
+	unsigned char block[64];
+	size_t blocksz;
+};
+
+void
+sha256_init(struct sha256 *);
+
+void
+sha256_update(struct sha256 *, const void *, size_t);
+
+void
+sha256_final(struct sha256 *, unsigned char [SHA256_DIGEST_LENGTH]);
+
+/**
+ * Convenient function to compute the lowercase hexadecimal digest of data
+ * in one call.
+ */
+void
+sha256_hex(const void *, size_t, char [SHA256_HEX_LENGTH]);
+
+#endif /* !PASTER_SHA256_H */
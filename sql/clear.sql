@@ -18,4 +18,9 @@
 
 DELETE
   FROM paste
- WHERE strftime('%s', 'now') - strftime('%s', date) >= `duration`
+ WHERE rowid IN (
+	SELECT rowid
+	  FROM paste
+	 WHERE `expires_at` <= unixepoch()
+	 LIMIT ?
+ )
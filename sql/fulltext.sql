@@ -0,0 +1,37 @@
+--
+-- fulltext.sql -- search public pastes by title and code
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+SELECT p.`id`
+     , p.`title`
+     , p.`author`
+     , p.`language`
+     , p.`date`
+     , p.`visible`
+     , p.`duration`
+     , snippet(paste_fts, 1, char(2), char(3), '...', 16)
+     , bm25(paste_fts, 10.0, 1.0)
+  FROM paste_fts
+  JOIN paste p ON p.rowid = paste_fts.rowid
+ WHERE paste_fts MATCH ?
+   AND p.`title` like ?
+   AND p.`author` like ?
+   AND p.`language` like ?
+   AND p.`visible` = 1
+   AND p.`expires_at` > unixepoch()
+ ORDER BY bm25(paste_fts, 10.0, 1.0)
+ LIMIT ?
@@ -16,13 +16,16 @@
 -- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 --
 
-SELECT `id`
-     , `title`
-     , `author`
-     , `language`
-     , `code`
-     , strftime('%s', `date`)
-     , `visible`
-     , `duration`
-  FROM `paste`
- WHERE `id` = ?
+SELECT p.`id`
+     , p.`title`
+     , p.`author`
+     , p.`language`
+     , p.`date`
+     , p.`visible`
+     , p.`duration`
+     , b.`code`
+     , b.`encoding`
+  FROM paste p
+  JOIN body b ON b.`hash` = p.`hash`
+ WHERE p.`id` = ?
+   AND p.`expires_at` > unixepoch()
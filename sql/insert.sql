@@ -21,7 +21,9 @@ INSERT INTO paste(
   `title`,
   `author`,
   `language`,
-  `code`,
   `visible`,
-  `duration`
-) VALUES (?, ?, ?, ?, ?, ?, ?)
+  `duration`,
+  `date`,
+  `expires_at`,
+  `hash`
+) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?8, ?8 + ?6, ?7)
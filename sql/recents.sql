@@ -16,15 +16,18 @@
 -- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 --
 
+-- Expired pastes may wait for the next cleanup or for their bucket to be
+-- removed, date and duration are read from the index unlike expires_at.
 SELECT `id`
      , `title`
      , `author`
      , `language`
-     , `code`
-     , strftime('%s', date)
+     , `date`
      , `visible`
      , `duration`
   FROM paste
  WHERE `visible` = 1
- ORDER BY date DESC
+   AND `date` + `duration` > unixepoch()
+   AND (`date`, `id`) < (?, ?)
+ ORDER BY `date` DESC, `id` DESC
  LIMIT ?
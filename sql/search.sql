@@ -20,8 +20,7 @@ SELECT `id`
      , `title`
      , `author`
      , `language`
-     , `code`
-     , strftime('%s', date)
+     , `date`
      , `visible`
      , `duration`
   FROM paste
@@ -29,5 +28,7 @@ SELECT `id`
    AND `author` like ?
    AND `language` like ?
    AND `visible` = 1
- ORDER BY date DESC
+   AND `expires_at` > unixepoch()
+   AND (`date`, `id`) < (?, ?)
+ ORDER BY `date` DESC, `id` DESC
  LIMIT ?
@@ -0,0 +1,36 @@
+--
+-- substring.sql -- search public pastes by title and author substrings
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- The trigram index only returns candidates, the LIKE filters verify them.
+SELECT `id`
+     , `title`
+     , `author`
+     , `language`
+     , `date`
+     , `visible`
+     , `duration`
+  FROM paste
+ WHERE rowid IN (SELECT rowid FROM paste_trigram WHERE paste_trigram MATCH ?)
+   AND `title` like ?
+   AND `author` like ?
+   AND `language` like ?
+   AND `visible` = 1
+   AND `expires_at` > unixepoch()
+   AND (`date`, `id`) < (?, ?)
+ ORDER BY `date` DESC, `id` DESC
+ LIMIT ?
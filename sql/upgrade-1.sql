@@ -0,0 +1,27 @@
+--
+-- upgrade-1.sql -- integer timestamps and recents index
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Dates used to be stored as CURRENT_TIMESTAMP text.
+UPDATE paste
+   SET `date` = CAST(strftime('%s', `date`) AS INT)
+ WHERE typeof(`date`) = 'text';
+
+-- Walked in date order by recents and search, only public pastes are listed.
+CREATE INDEX IF NOT EXISTS paste_recents
+    ON paste(`date` DESC, `id`, `title`, `author`, `language`, `visible`, `duration`)
+ WHERE `visible` = 1;
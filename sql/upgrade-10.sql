@@ -0,0 +1,24 @@
+--
+-- upgrade-10.sql -- incremental vacuum
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Files created before incremental vacuum was enabled are converted by a
+-- full VACUUM which cannot run inside a transaction, it is done before this
+-- upgrade. VACUUM may renumber the implicit paste rowids both indexes refer
+-- to, readers only use them once this upgrade is committed.
+INSERT INTO paste_fts(paste_fts) VALUES ('rebuild');
+INSERT INTO paste_trigram(paste_trigram) VALUES ('rebuild');
@@ -0,0 +1,36 @@
+--
+-- upgrade-11.sql -- journal of new identifiers
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Every identifier stored is also recorded in order so that the membership
+-- filters of the other processes only read the new ones. The sequence never
+-- goes back, even once old entries are pruned.
+CREATE TABLE IF NOT EXISTS paste_added(
+	`seq`           INTEGER primary key autoincrement,
+	`id`            TEXT not null,
+	`date`          INT not null
+);
+
+CREATE TRIGGER IF NOT EXISTS paste_added_paste AFTER INSERT ON paste
+BEGIN
+	INSERT INTO paste_added(`id`, `date`) VALUES (new.`id`, unixepoch());
+END;
+
+CREATE TRIGGER IF NOT EXISTS paste_added_bucket AFTER INSERT ON paste_bucket
+BEGIN
+	INSERT INTO paste_added(`id`, `date`) VALUES (new.`id`, unixepoch());
+END;
@@ -0,0 +1,38 @@
+--
+-- upgrade-3.sql -- full text index over titles and code
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+CREATE VIRTUAL TABLE IF NOT EXISTS paste_fts USING fts5(
+	`title`,
+	`code`,
+	content = 'paste',
+	content_rowid = 'rowid'
+);
+
+CREATE TRIGGER IF NOT EXISTS paste_fts_insert AFTER INSERT ON paste
+BEGIN
+	INSERT INTO paste_fts(rowid, `title`, `code`)
+	VALUES (new.rowid, new.`title`, new.`code`);
+END;
+
+CREATE TRIGGER IF NOT EXISTS paste_fts_delete AFTER DELETE ON paste
+BEGIN
+	INSERT INTO paste_fts(paste_fts, rowid, `title`, `code`)
+	VALUES ('delete', old.rowid, old.`title`, old.`code`);
+END;
+
+INSERT INTO paste_fts(paste_fts) VALUES ('rebuild');
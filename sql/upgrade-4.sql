@@ -0,0 +1,39 @@
+--
+-- upgrade-4.sql -- trigram index over titles and authors
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+CREATE VIRTUAL TABLE IF NOT EXISTS paste_trigram USING fts5(
+	`title`,
+	`author`,
+	content = 'paste',
+	content_rowid = 'rowid',
+	tokenize = 'trigram'
+);
+
+CREATE TRIGGER IF NOT EXISTS paste_trigram_insert AFTER INSERT ON paste
+BEGIN
+	INSERT INTO paste_trigram(rowid, `title`, `author`)
+	VALUES (new.rowid, new.`title`, new.`author`);
+END;
+
+CREATE TRIGGER IF NOT EXISTS paste_trigram_delete AFTER DELETE ON paste
+BEGIN
+	INSERT INTO paste_trigram(paste_trigram, rowid, `title`, `author`)
+	VALUES ('delete', old.rowid, old.`title`, old.`author`);
+END;
+
+INSERT INTO paste_trigram(paste_trigram) VALUES ('rebuild');
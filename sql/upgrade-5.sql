@@ -0,0 +1,70 @@
+--
+-- upgrade-5.sql -- move paste bodies out of the paste table
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Listings only need the metadata, keep large bodies in their own table.
+CREATE TABLE IF NOT EXISTS body(
+	`id`            TEXT primary key,
+	`code`          TEXT not null
+);
+
+INSERT INTO body(`id`, `code`)
+SELECT `id`, `code`
+  FROM paste;
+
+-- The full text index reads the code from the body table from now on.
+DROP TRIGGER IF EXISTS paste_fts_insert;
+DROP TRIGGER IF EXISTS paste_fts_delete;
+DROP TABLE IF EXISTS paste_fts;
+
+ALTER TABLE paste DROP COLUMN `code`;
+
+CREATE VIEW IF NOT EXISTS paste_text AS
+SELECT paste.rowid AS `pid`
+     , paste.`title` AS `title`
+     , body.`code` AS `code`
+  FROM paste
+  JOIN body ON body.`id` = paste.`id`;
+
+CREATE VIRTUAL TABLE IF NOT EXISTS paste_fts USING fts5(
+	`title`,
+	`code`,
+	content = 'paste_text',
+	content_rowid = 'pid'
+);
+
+-- The body is always inserted after its paste.
+CREATE TRIGGER IF NOT EXISTS body_insert AFTER INSERT ON body
+BEGIN
+	INSERT INTO paste_fts(rowid, `title`, `code`)
+	SELECT rowid, `title`, new.`code`
+	  FROM paste
+	 WHERE `id` = new.`id`;
+END;
+
+CREATE TRIGGER IF NOT EXISTS paste_delete AFTER DELETE ON paste
+BEGIN
+	INSERT INTO paste_fts(paste_fts, rowid, `title`, `code`)
+	SELECT 'delete', old.rowid, old.`title`, `code`
+	  FROM body
+	 WHERE `id` = old.`id`;
+
+	DELETE FROM body WHERE `id` = old.`id`;
+END;
+
+INSERT INTO paste_fts(paste_fts) VALUES ('rebuild');
+INSERT INTO paste_trigram(paste_trigram) VALUES ('rebuild');
@@ -0,0 +1,52 @@
+--
+-- upgrade-6.sql -- optional compression of paste bodies
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- 0: plain text, 1: gzip, see enum paste_encoding.
+ALTER TABLE body ADD COLUMN `encoding` INT not null default 0;
+
+-- Indexing needs the plain text, body_text() is registered by pasterd.
+DROP VIEW IF EXISTS paste_text;
+
+CREATE VIEW IF NOT EXISTS paste_text AS
+SELECT paste.rowid AS `pid`
+     , paste.`title` AS `title`
+     , body_text(body.`code`, body.`encoding`) AS `code`
+  FROM paste
+  JOIN body ON body.`id` = paste.`id`;
+
+DROP TRIGGER IF EXISTS body_insert;
+
+CREATE TRIGGER IF NOT EXISTS body_insert AFTER INSERT ON body
+BEGIN
+	INSERT INTO paste_fts(rowid, `title`, `code`)
+	SELECT rowid, `title`, body_text(new.`code`, new.`encoding`)
+	  FROM paste
+	 WHERE `id` = new.`id`;
+END;
+
+DROP TRIGGER IF EXISTS paste_delete;
+
+CREATE TRIGGER IF NOT EXISTS paste_delete AFTER DELETE ON paste
+BEGIN
+	INSERT INTO paste_fts(paste_fts, rowid, `title`, `code`)
+	SELECT 'delete', old.rowid, old.`title`, body_text(`code`, `encoding`)
+	  FROM body
+	 WHERE `id` = old.`id`;
+
+	DELETE FROM body WHERE `id` = old.`id`;
+END;
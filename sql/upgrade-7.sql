@@ -0,0 +1,75 @@
+--
+-- upgrade-7.sql -- share identical paste bodies
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Bodies are keyed by the SHA-256 of their plain text and shared by every
+-- paste with the same content, refs counts those pastes.
+DROP VIEW IF EXISTS paste_text;
+DROP TRIGGER IF EXISTS body_insert;
+DROP TRIGGER IF EXISTS paste_delete;
+
+ALTER TABLE paste ADD COLUMN `hash` TEXT;
+
+UPDATE paste
+   SET `hash` = (
+	SELECT sha256(body_text(body.`code`, body.`encoding`))
+	  FROM body
+	 WHERE body.`id` = paste.`id`
+   );
+
+CREATE TABLE IF NOT EXISTS content(
+	`hash`          TEXT primary key,
+	`code`          TEXT not null,
+	`encoding`      INT not null default 0,
+	`refs`          INT not null default 0
+);
+
+INSERT INTO content(`hash`, `code`, `encoding`, `refs`)
+SELECT paste.`hash`, body.`code`, body.`encoding`, count(*)
+  FROM paste
+  JOIN body ON body.`id` = paste.`id`
+ GROUP BY paste.`hash`;
+
+DROP TABLE body;
+ALTER TABLE content RENAME TO body;
+
+CREATE VIEW IF NOT EXISTS paste_text AS
+SELECT paste.rowid AS `pid`
+     , paste.`title` AS `title`
+     , body_text(body.`code`, body.`encoding`) AS `code`
+  FROM paste
+  JOIN body ON body.`hash` = paste.`hash`;
+
+-- The body is now stored or referenced before its paste.
+CREATE TRIGGER IF NOT EXISTS paste_insert AFTER INSERT ON paste
+BEGIN
+	INSERT INTO paste_fts(rowid, `title`, `code`)
+	SELECT new.rowid, new.`title`, body_text(`code`, `encoding`)
+	  FROM body
+	 WHERE `hash` = new.`hash`;
+END;
+
+CREATE TRIGGER IF NOT EXISTS paste_delete AFTER DELETE ON paste
+BEGIN
+	INSERT INTO paste_fts(paste_fts, rowid, `title`, `code`)
+	SELECT 'delete', old.rowid, old.`title`, body_text(`code`, `encoding`)
+	  FROM body
+	 WHERE `hash` = old.`hash`;
+
+	UPDATE body SET `refs` = `refs` - 1 WHERE `hash` = old.`hash`;
+	DELETE FROM body WHERE `hash` = old.`hash` AND `refs` <= 0;
+END;
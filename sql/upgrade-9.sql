@@ -0,0 +1,37 @@
+--
+-- upgrade-9.sql -- time buckets holding pastes by expiration
+--
+-- Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+--
+-- Permission to use, copy, modify, and/or distribute this software for any
+-- purpose with or without fee is hereby granted, provided that the above
+-- copyright notice and this permission notice appear in all copies.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+-- WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+-- MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+-- ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+-- WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+-- ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+-- OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+--
+
+-- Pastes may be stored in bucket files, one per expiration period, so that
+-- they are removed all at once. Every shard lists the buckets its pastes
+-- were stored in and where each of them is, a bucket is named after the
+-- time all its pastes have expired.
+CREATE TABLE IF NOT EXISTS bucket(
+	`expires_before`        INT primary key
+) WITHOUT ROWID;
+
+CREATE TABLE IF NOT EXISTS paste_bucket(
+	`id`                    TEXT primary key,
+	`expires_before`        INT not null
+) WITHOUT ROWID;
+
+CREATE INDEX IF NOT EXISTS paste_bucket_expires ON paste_bucket(`expires_before`);
+
+CREATE TRIGGER IF NOT EXISTS bucket_delete AFTER DELETE ON bucket
+BEGIN
+	DELETE FROM paste_bucket WHERE `expires_before` = old.`expires_before`;
+END;
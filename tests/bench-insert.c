@@ -0,0 +1,155 @@
+/*
+ * bench-insert.c -- insert throughput against the number of shards
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "database.h"
+#include "paste.h"
+#include "util.h"
+
+#define BENCH_DATABASE "bench.db"
+#define MAX_SHARDS 8
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+clean(void)
+{
+	char base[64];
+
+	for (int i = 0; i < MAX_SHARDS; ++i) {
+		if (i)
+			snprintf(base, sizeof (base), "%s.%d", BENCH_DATABASE, i);
+		else
+			snprintf(base, sizeof (base), "%s", BENCH_DATABASE);
+
+		remove(base);
+		remove(bprintf("%s-shm", base));
+		remove(bprintf("%s-wal", base));
+	}
+}
+
+/*
+ * Sharding only pays off when workers actually run in parallel, results
+ * depend on the number of cores and on the cost of a commit on the storage.
+ *
+ * Each worker is a process with its own connections like kfcgi workers are,
+ * they all insert at the same time.
+ */
+static void
+worker(int id, int pastes)
+{
+	struct paste paste = {0};
+
+	if (database_open(&database, BENCH_DATABASE) < 0)
+		exit(1);
+
+	for (int i = 0; i < pastes; ++i) {
+		paste.title = estrdup(bprintf("worker %d paste %d", id, i));
+		paste.author = estrdup("bench");
+		paste.language = estrdup("nohighlight");
+		paste.code = estrdup(bprintf("int main(void) { return %d%d; }", id, i));
+		paste.duration = 86400;
+		paste.visible = 1;
+
+		if (database_insert(&database, &paste) < 0)
+			exit(1);
+
+		paste_finish(&paste);
+	}
+
+	database_finish(&database);
+	exit(0);
+}
+
+static double
+run(size_t shards, int workers, int pastes)
+{
+	double start;
+	int status, failed = 0;
+
+	clean();
+	config.databaseshards = shards;
+
+	/* Create the files and schema before timing. */
+	if (database_open(&database, BENCH_DATABASE) < 0)
+		die("abort: could not open database\n");
+
+	database_finish(&database);
+	fflush(stdout);
+	start = now();
+
+	for (int i = 0; i < workers; ++i) {
+		switch (fork()) {
+		case -1:
+			die("abort: fork failed\n");
+			break;
+		case 0:
+			worker(i, pastes);
+			break;
+		default:
+			break;
+		}
+	}
+
+	while (wait(&status) > 0)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+
+	if (failed)
+		die("abort: a worker failed\n");
+
+	return workers * pastes / ((now() - start) / 1000.0);
+}
+
+int
+main(int argc, char **argv)
+{
+	int workers = argc > 1 ? atoi(argv[1]) : 8;
+	int pastes = argc > 2 ? atoi(argv[2]) : 500;
+
+	config.verbosity = 0;
+
+	/* Optional profile, commits are most expensive with the safe one. */
+	if (argc > 3)
+		snprintf(config.databaseprofile, sizeof (config.databaseprofile), "%s", argv[3]);
+
+	printf("%d workers inserting %d pastes each (profile %s)\n",
+	    workers, pastes, config.databaseprofile);
+	printf("%-8s%16s\n", "shards", "pastes/s");
+
+	for (size_t shards = 1; shards <= MAX_SHARDS; shards *= 2)
+		printf("%-8zu%16.0f\n", shards, run(shards, workers, pastes));
+
+	clean();
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * bench-search.c -- compare substring search strategies
+ *
+ * Copyright (c) 2020-2023 David Demelier <markand@malikania.fr>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sqlite3.h>
+
+#include "config.h"
+#include "database.h"
+#include "database-sqlite.h"
+#include "paste.h"
+#include "util.h"
+
+#include "sql/search.h"
+
+#define BENCH_DATABASE "bench.db"
+#define ROUNDS 20
+#define LIMIT 16
+
+/* Connection of the first shard. */
+#define HANDLE (((struct database_sqlite *)database.data)->shards[0].handle)
+
+/*
+ * Rows are generated by SQLite itself so that populating a million pastes
+ * takes seconds rather than a million individual inserts.
+ */
+static const char populate[] =
+	"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %lld) "
+	"INSERT INTO body(hash, code, encoding, refs) "
+	"SELECT sha256('int main(void) { return ' || i || '; }'), "
+	"       'int main(void) { return ' || i || '; }', 0, 1 "
+	"  FROM n;"
+	"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %lld) "
+	"INSERT INTO paste(id, title, author, language, visible, duration, date, expires_at, hash) "
+	"SELECT lower(hex(randomblob(6))), "
+	"       'title ' || lower(hex(randomblob(8))), "
+	"       'author' || (abs(random()) % 100000), "
+	"       'nohighlight', "
+	"       1, 86400, unixepoch() - i, unixepoch() - i + 86400, "
+	"       sha256('int main(void) { return ' || i || '; }') "
+	"  FROM n";
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Pick needles among existing rows so that every query has results.
+ */
+static void
+needles(char titles[ROUNDS][8], char authors[ROUNDS][8])
+{
+	sqlite3_stmt *stmt;
+	int i = 0;
+
+	sqlite3_prepare_v2(HANDLE,
+	    "SELECT substr(title, 9, 5), substr(author, 7, 4) FROM paste ORDER BY random() LIMIT ?",
+	    -1, &stmt, NULL);
+	sqlite3_bind_int(stmt, 1, ROUNDS);
+
+	for (; i < ROUNDS && sqlite3_step(stmt) == SQLITE_ROW; ++i) {
+		snprintf(titles[i], 8, "%s", sqlite3_column_text(stmt, 0));
+		snprintf(authors[i], 8, "%s", sqlite3_column_text(stmt, 1));
+	}
+
+	sqlite3_finalize(stmt);
+}
+
+static double
+like(const char *title, const char *author)
+{
+	sqlite3_stmt *stmt;
+	double start = now();
+
+	sqlite3_prepare_v2(HANDLE, (const char *)sql_search, -1, &stmt, NULL);
+	sqlite3_bind_text(stmt, 1, bprintf("%%%s%%", title), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 2, bprintf("%%%s%%", author), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 3, "%", -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 4, INT64_MAX);
+	sqlite3_bind_text(stmt, 5, "", -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 6, LIMIT);
+
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		continue;
+
+	sqlite3_finalize(stmt);
+
+	return now() - start;
+}
+
+static double
+trigram(const char *title, const char *author)
+{
+	struct paste pastes[LIMIT];
+	size_t pastesz = LIMIT;
+	double start = now();
+
+	database_search(&database, pastes, &pastesz, title, author, NULL, NULL, NULL);
+
+	for (size_t i = 0; i < pastesz; ++i)
+		paste_finish(&pastes[i]);
+
+	return now() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+	char titles[ROUNDS][8] = {0}, authors[ROUNDS][8] = {0};
+	long long int rows = argc > 1 ? atoll(argv[1]) : 1000000;
+	double start, tlike[2] = {0}, ttrigram[2] = {0};
+
+	config.verbosity = 0;
+	remove(BENCH_DATABASE);
+	remove(BENCH_DATABASE "-shm");
+	remove(BENCH_DATABASE "-wal");
+
+	if (database_open(&database, BENCH_DATABASE) < 0)
+		die("abort: could not open database\n");
+
+	printf("populating %lld pastes... ", rows);
+	fflush(stdout);
+	start = now();
+
+	if (sqlite3_exec(HANDLE, bprintf(populate, rows, rows), NULL, NULL, NULL) != SQLITE_OK)
+		die("abort: %s\n", sqlite3_errmsg(HANDLE));
+
+	printf("%.0f ms\n", now() - start);
+	needles(titles, authors);
+
+	for (int i = 0; i < ROUNDS; ++i) {
+		tlike[0] += like(titles[i], "");
+		tlike[1] += like("", authors[i]);
+		ttrigram[0] += trigram(titles[i], NULL);
+		ttrigram[1] += trigram(NULL, authors[i]);
+	}
+
+	printf("%-16s%12s%12s\n", "", "LIKE", "trigram");
+	printf("%-16s%9.3f ms%9.3f ms\n", "title", tlike[0] / ROUNDS, ttrigram[0] / ROUNDS);
+	printf("%-16s%9.3f ms%9.3f ms\n", "author", tlike[1] / ROUNDS, ttrigram[1] / ROUNDS);
+
+	database_finish(&database);
+	remove(BENCH_DATABASE);
+
+	return 0;
+}
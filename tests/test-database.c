@@ -16,25 +16,82 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <glob.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <sqlite3.h>
+
 #define GREATEST_USE_ABBREVS 0
 #include <greatest.h>
 
+#include "arena.h"
+#include "config.h"
 #include "database.h"
+#include "database-sqlite.h"
+#include "gzip.h"
 #include "paste.h"
 #include "util.h"
 
 #define TEST_DATABASE "test.db"
+#define TEST_SHARDS 4
+#define TEST_LOG "test.log"
+
+#define SQLITE(db) ((struct database_sqlite *)(db).data)
 
 static void
 setup(void *data)
 {
-	remove(TEST_DATABASE);
+	char base[64];
+	glob_t buckets;
+
+	/* The shards suite passes the number of database files to use. */
+	config.databaseshards = data ? *(const size_t *)data : 1;
+	snprintf(config.databaseengine, sizeof (config.databaseengine), "sqlite");
+
+	if (glob(TEST_DATABASE ".bucket-*", 0, NULL, &buckets) == 0) {
+		for (size_t i = 0; i < buckets.gl_pathc; ++i)
+			remove(buckets.gl_pathv[i]);
 
-	if (!database_open(TEST_DATABASE))
+		globfree(&buckets);
+	}
+
+	for (size_t i = 0; i < TEST_SHARDS; ++i) {
+		if (i)
+			snprintf(base, sizeof (base), "%s.%zu", TEST_DATABASE, i);
+		else
+			snprintf(base, sizeof (base), "%s", TEST_DATABASE);
+
+		remove(base);
+		remove(bprintf("%s-shm", base));
+		remove(bprintf("%s-wal", base));
+	}
+
+	if (database_open(&database, TEST_DATABASE) < 0)
 		die("abort: could not open database");
+}
+
+static void
+setup_buckets(void *data)
+{
+	/* One bucket per second so that tests do not wait for long. */
+	config.databasebucket = 1;
+	setup(data);
+}
+
+static void
+setup_log(void *data)
+{
+	snprintf(config.databaseengine, sizeof (config.databaseengine), "log");
+	remove(TEST_LOG);
+	remove(TEST_LOG ".tmp");
+
+	if (database_open(&database, TEST_LOG) < 0)
+		die("abort: could not open log");
 
 	(void)data;
 }
@@ -42,7 +99,8 @@ setup(void *data)
 static void
 finish(void *data)
 {
-	database_finish();
+	database_finish(&database);
+	config.databasebucket = 0;
 
 	(void)data;
 }
@@ -53,7 +111,7 @@ recents_empty(void)
 	struct paste pastes[10];
 	size_t max = 10;
 
-	if (!database_recents(pastes, &max))
+	if (database_recents(&database, pastes, &max, NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 0);
@@ -74,9 +132,9 @@ recents_one(void)
 		.visible = true
 	};
 
-	if (!database_insert(&one))
+	if (database_insert(&database, &one) < 0)
 		GREATEST_FAIL();
-	if (!database_recents(pastes, &max))
+	if (database_recents(&database, pastes, &max, NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 1);
@@ -84,7 +142,7 @@ recents_one(void)
 	GREATEST_ASSERT_STR_EQ(pastes[0].title, "test 1");
 	GREATEST_ASSERT_STR_EQ(pastes[0].author, "unit test");
 	GREATEST_ASSERT_STR_EQ(pastes[0].language, "cpp");
-	GREATEST_ASSERT_STR_EQ(pastes[0].code, "int main() {}");
+	GREATEST_ASSERT(!pastes[0].code);
 	GREATEST_ASSERT_EQ(pastes[0].duration, PASTE_DURATION_HOUR);
 	GREATEST_ASSERT(pastes[0].visible);
 	GREATEST_PASS();
@@ -105,9 +163,9 @@ recents_hidden(void)
 		.visible = false
 	};
 
-	if (!database_insert(&one))
+	if (database_insert(&database, &one) < 0)
 		GREATEST_FAIL();
-	if (!database_recents(pastes, &max))
+	if (database_recents(&database, pastes, &max, NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 0);
@@ -131,14 +189,14 @@ recents_many(void)
 		pastie.language = estrdup("cpp");
 		pastie.code = estrdup(bprintf("int main() { return %d; }", i));
 
-		if (!database_insert(&pastie))
+		if (database_insert(&database, &pastie) < 0)
 			GREATEST_FAIL();
 
 		/* Sleep a little bit to avoid same timestamp. */
 		sleep(2);
 	};
 
-	if (!database_recents(pastes, &max))
+	if (database_recents(&database, pastes, &max, NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 3U);
@@ -151,8 +209,7 @@ recents_many(void)
 		GREATEST_ASSERT_STR_EQ(pastes[i].author,
 		    bprintf("unit test %d", expected[i]));
 		GREATEST_ASSERT_STR_EQ(pastes[i].language, "cpp");
-		GREATEST_ASSERT_STR_EQ(pastes[i].code,
-		    bprintf("int main() { return %d; }", expected[i]));
+		GREATEST_ASSERT(!pastes[i].code);
 		GREATEST_ASSERT_EQ(pastes[i].duration, PASTE_DURATION_HOUR);
 		GREATEST_ASSERT(pastes[i].visible);
 	};
@@ -177,14 +234,14 @@ recents_limits(void)
 		pastie.language = estrdup("cpp");
 		pastie.code = estrdup(bprintf("int main() { return %d; }", i));
 
-		if (!database_insert(&pastie))
+		if (database_insert(&database, &pastie) < 0)
 			GREATEST_FAIL();
 
 		/* Sleep a little bit to avoid same timestamp. */
 		sleep(2);
 	};
 
-	if (!database_recents(pastes, &max))
+	if (database_recents(&database, pastes, &max, NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 3U);
@@ -197,8 +254,7 @@ recents_limits(void)
 		GREATEST_ASSERT_STR_EQ(pastes[i].author,
 		    bprintf("unit test %d", expected[i]));
 		GREATEST_ASSERT_STR_EQ(pastes[i].language, "cpp");
-		GREATEST_ASSERT_STR_EQ(pastes[i].code,
-		    bprintf("int main() { return %d; }", expected[i]));
+		GREATEST_ASSERT(!pastes[i].code);
 		GREATEST_ASSERT_EQ(pastes[i].duration, PASTE_DURATION_HOUR);
 		GREATEST_ASSERT(pastes[i].visible);
 	};
@@ -206,6 +262,188 @@ recents_limits(void)
 	GREATEST_PASS();
 }
 
+GREATEST_TEST
+recents_after(void)
+{
+	struct paste pastes[3] = { 0 }, seen[10] = { 0 }, pastie = { 0 };
+	size_t max, seensz = 0;
+
+	/* Inserted in the same second, only the id orders them. */
+	for (int i = 0; i < 10; ++i) {
+		pastie.duration = PASTE_DURATION_HOUR;
+		pastie.visible = true;
+		pastie.title = estrdup(bprintf("test %d", i));
+		pastie.author = estrdup("unit test");
+		pastie.language = estrdup("cpp");
+		pastie.code = estrdup("int main() {}");
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&pastie);
+	}
+
+	/* Walk every page, each paste must be seen exactly once. */
+	do {
+		max = NELEM(pastes);
+
+		if (database_recents(&database, pastes, &max, seensz ? &seen[seensz - 1] : NULL) < 0)
+			GREATEST_FAIL();
+
+		for (size_t i = 0; i < max; ++i) {
+			for (size_t j = 0; j < seensz; ++j)
+				GREATEST_ASSERT(strcmp(seen[j].id, pastes[i].id) != 0);
+
+			GREATEST_ASSERT(seensz < NELEM(seen));
+			seen[seensz++] = pastes[i];
+		}
+	} while (max == NELEM(pastes));
+
+	GREATEST_ASSERT_EQ(seensz, 10U);
+
+	for (size_t i = 0; i < seensz; ++i)
+		paste_finish(&seen[i]);
+
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+recents_cursor(void)
+{
+	struct database_cursor cursor;
+	struct paste pastes[3], pastie = { 0 };
+	size_t max = NELEM(pastes), n = 0;
+	int rc;
+
+	for (int i = 0; i < 5; ++i) {
+		pastie.duration = PASTE_DURATION_HOUR;
+		pastie.visible = true;
+		pastie.title = estrdup(bprintf("cursor %d", i));
+		pastie.author = estrdup("unit test");
+		pastie.language = estrdup("cpp");
+		pastie.code = estrdup("int main() {}");
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&pastie);
+	}
+
+	if (database_recents(&database, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	/* Same rows as the copying listing, borrowed and not NUL terminated. */
+	if (database_cursor_recents(&database, &cursor, NELEM(pastes), NULL) < 0)
+		GREATEST_FAIL();
+
+	while ((rc = database_cursor_next(&cursor)) > 0) {
+		GREATEST_ASSERT(n < max);
+		GREATEST_ASSERT_EQ(cursor.row.id.len, strlen(pastes[n].id));
+		GREATEST_ASSERT(memcmp(cursor.row.id.data, pastes[n].id, cursor.row.id.len) == 0);
+		GREATEST_ASSERT_EQ(cursor.row.title.len, strlen("cursor 0"));
+		GREATEST_ASSERT(memcmp(cursor.row.title.data, pastes[n].title, cursor.row.title.len) == 0);
+		GREATEST_ASSERT_EQ(cursor.row.timestamp, pastes[n].timestamp);
+		GREATEST_ASSERT(!cursor.row.snippet.data);
+		n++;
+	}
+
+	database_cursor_finish(&cursor);
+
+	GREATEST_ASSERT_EQ(rc, 0);
+	GREATEST_ASSERT_EQ(n, 3U);
+
+	for (size_t i = 0; i < max; ++i)
+		paste_finish(&pastes[i]);
+
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+recents_snapshot(void)
+{
+	const struct database_recents *first, *second;
+	struct database other;
+	struct paste pastie;
+
+	paste_init(&pastie);
+	pastie.visible = true;
+	pastie.code = estrdup("int main() {}");
+
+	if (database_insert(&database, &pastie) < 0)
+		GREATEST_FAIL();
+	if (!(first = database_recents_snapshot(&database)))
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(first->pastesz, 1U);
+	GREATEST_ASSERT_STR_EQ(first->pastes[0].id, pastie.id);
+
+	/* Nothing changed, same snapshot. */
+	GREATEST_ASSERT(database_recents_snapshot(&database) == first);
+
+	/* Private pastes are not listed either. */
+	pastie.visible = false;
+
+	if (database_insert(&database, &pastie) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(database_recents_snapshot(&database) == first);
+
+	/* A paste from another process. */
+	if (database_open(&other, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	pastie.visible = true;
+
+	if (database_insert(&other, &pastie) < 0)
+		GREATEST_FAIL();
+
+	database_finish(&other);
+
+	if (!(second = database_recents_snapshot(&database)))
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(second != first);
+	GREATEST_ASSERT_EQ(second->pastesz, 2U);
+	GREATEST_ASSERT(strcmp(second->pastes[0].id, pastie.id) == 0 ||
+	                strcmp(second->pastes[1].id, pastie.id) == 0);
+
+	/* The previous one is still readable. */
+	GREATEST_ASSERT_EQ(first->pastesz, 1U);
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+recents_snapshot_expired(void)
+{
+	const struct database_recents *first, *second;
+	struct paste pastie;
+
+	paste_init(&pastie);
+	pastie.visible = true;
+	pastie.code = estrdup("int main() {}");
+	pastie.duration = 1;
+
+	if (database_insert(&database, &pastie) < 0)
+		GREATEST_FAIL();
+	if (!(first = database_recents_snapshot(&database)))
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(first->pastesz, 1U);
+
+	/* Rebuilt once the paste has expired, without any commit. */
+	sleep(2);
+
+	if (!(second = database_recents_snapshot(&database)))
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(second != first);
+	GREATEST_ASSERT_EQ(second->pastesz, 0U);
+	GREATEST_ASSERT(database_recents_snapshot(&database) == second);
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
 GREATEST_SUITE(recents)
 {
 	GREATEST_SET_SETUP_CB(setup, NULL);
@@ -215,6 +453,10 @@ GREATEST_SUITE(recents)
 	GREATEST_RUN_TEST(recents_hidden);
 	GREATEST_RUN_TEST(recents_many);
 	GREATEST_RUN_TEST(recents_limits);
+	GREATEST_RUN_TEST(recents_after);
+	GREATEST_RUN_TEST(recents_cursor);
+	GREATEST_RUN_TEST(recents_snapshot);
+	GREATEST_RUN_TEST(recents_snapshot_expired);
 }
 
 GREATEST_TEST
@@ -230,9 +472,9 @@ get_basic(void)
 	};
 	struct paste new = { 0 };
 
-	if (!database_insert(&original))
+	if (database_insert(&database, &original) < 0)
 		GREATEST_FAIL();
-	if (!database_get(&new, original.id))
+	if (database_get(&database, &new, original.id) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_STR_EQ(new.id, original.id);
@@ -249,7 +491,7 @@ get_nonexistent(void)
 {
 	struct paste new = { 0 };
 
-	GREATEST_ASSERT(!database_get(&new, "unknown"));
+	GREATEST_ASSERT(database_get(&database, &new, "unknown") < 0);
 	GREATEST_ASSERT(!new.id);
 	GREATEST_ASSERT(!new.title);
 	GREATEST_ASSERT(!new.author);
@@ -258,176 +500,426 @@ get_nonexistent(void)
 	GREATEST_PASS();
 }
 
-GREATEST_SUITE(get)
-{
-	GREATEST_SET_SETUP_CB(setup, NULL);
-	GREATEST_SET_TEARDOWN_CB(finish, NULL);
-	GREATEST_RUN_TEST(get_basic);
-	GREATEST_RUN_TEST(get_nonexistent);
-}
-
 GREATEST_TEST
-search_basic(void)
+get_compressed(void)
 {
-	struct paste searched[3] = { 0 };
-	struct paste originals[] = {
-		{
-			.title = estrdup("This is in C"),
-			.author = estrdup("markand"),
-			.language = estrdup("cpp"),
-			.code = estrdup("int main(void) {}"),
-			.duration = PASTE_DURATION_HOUR,
-			.visible = true
-		},
-		{
-			.title = estrdup("This is in shell"),
-			.author = estrdup("markand"),
-			.language = estrdup("shell"),
-			.code = estrdup("f() {}"),
-			.duration = PASTE_DURATION_HOUR,
-			.visible = true
-		},
-		{
-			.title = estrdup("This is in python"),
-			.author = estrdup("NiReaS"),
-			.language = estrdup("python"),
-			.code = estrdup("f: pass"),
-			.duration = PASTE_DURATION_HOUR,
-			.visible = true
-		},
+	char code[4096] = {0};
+	struct paste original = {
+		.title = estrdup("big one"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = true
 	};
-	size_t max = 3;
+	struct paste new = { 0 }, searched = { 0 };
+	size_t max = 1;
 
-	for (int i = 0; i < 3; ++i)
-		if (!database_insert(&originals[i]))
-			GREATEST_FAIL();
+	for (size_t i = 0; i + 16 < sizeof (code); i += 16)
+		strcat(code, "int unique = 1;\n");
 
-	/*
-	 * Search:
-	 *
-	 * title = <any>
-	 * author = markand,
-	 * language = cpp
-	 */
-	if (!database_search(searched, &max, NULL, "markand", "cpp"))
+	original.code = estrdup(code);
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	/* Decoded by default. */
+	if (database_get(&database, &new, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_IDENTITY);
+	GREATEST_ASSERT_EQ(new.codesz, strlen(code));
+	GREATEST_ASSERT_STR_EQ(new.code, code);
+	paste_finish(&new);
+
+	/* Stored bytes for clients accepting gzip. */
+	if (database_get_encoded(&database, &new, original.id, PASTE_ENCODING_GZIP) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_GZIP);
+	GREATEST_ASSERT(new.codesz < strlen(code));
+
+	/* Still indexed as text. */
+	if (database_search(&database, &searched, &max, NULL, NULL, NULL, "unique", NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 1);
-	GREATEST_ASSERT(searched[0].id);
-	GREATEST_ASSERT_STR_EQ(searched[0].title, "This is in C");
-	GREATEST_ASSERT_STR_EQ(searched[0].author, "markand");
-	GREATEST_ASSERT_STR_EQ(searched[0].language, "cpp");
-	GREATEST_ASSERT_STR_EQ(searched[0].code, "int main(void) {}");
-	GREATEST_ASSERT_EQ(searched[0].duration, PASTE_DURATION_HOUR);
-	GREATEST_ASSERT(searched[0].visible);
 	GREATEST_PASS();
 }
 
 GREATEST_TEST
-search_notfound(void)
+get_stream(void)
 {
-	struct paste searched = { 0 };
+	static char code[3 * DATABASE_STREAM_CHUNK], got[sizeof (code)];
 	struct paste original = {
-		.title = estrdup("This is in C"),
-		.author = estrdup("markand"),
-		.language = estrdup("cpp"),
-		.code = estrdup("int main(void) {}"),
+		.title = estrdup("streamed"),
+		.author = estrdup("unit test"),
+		.language = estrdup("nohighlight"),
 		.duration = PASTE_DURATION_HOUR,
 		.visible = true
 	};
-	size_t max = 1;
+	struct paste new = { 0 };
+	struct database_stream stream;
+	unsigned int seed = 1;
+	size_t len = 0, plainsz;
+	long long int n;
+	char *plain;
+
+	/* Barely compressible so that the stored body spans several chunks. */
+	for (size_t i = 0; i + 1 < sizeof (code); ++i)
+		code[i] = 'a' + (seed = seed * 1103515245 + 12345) % 26;
+
+	original.code = estrdup(code);
 
-	if (!database_insert(&original))
+	if (database_insert(&database, &original) < 0)
 		GREATEST_FAIL();
 
-	/*
-	 * Search:
-	 *
-	 * title = <any>
-	 * author = jean,
-	 * language = <any>
-	 */
-	if (!database_search(&searched, &max, NULL, "jean", NULL))
+	/* Decoded on the fly with a buffer smaller than a chunk. */
+	if (database_stream_open(&database, &stream, &new, original.id, PASTE_ENCODING_IDENTITY) < 0)
 		GREATEST_FAIL();
 
-	GREATEST_ASSERT_EQ(max, 0);
-	GREATEST_ASSERT(!searched.id);
-	GREATEST_ASSERT(!searched.title);
-	GREATEST_ASSERT(!searched.author);
-	GREATEST_ASSERT(!searched.language);
-	GREATEST_ASSERT(!searched.code);
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_IDENTITY);
+	GREATEST_ASSERT_EQ(new.codesz, strlen(code));
+	GREATEST_ASSERT_STR_EQ(new.title, original.title);
+
+	while ((n = database_stream_read(&stream, got + len, 1000)) > 0)
+		len += n;
+
+	GREATEST_ASSERT_EQ(n, 0);
+	GREATEST_ASSERT_EQ(len, strlen(code));
+	GREATEST_ASSERT(memcmp(got, code, len) == 0);
+	database_stream_close(&stream);
+	paste_finish(&new);
+
+	/* Stored bytes as is. */
+	if (database_stream_open(&database, &stream, &new, original.id, PASTE_ENCODING_GZIP) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_GZIP);
+
+	for (len = 0; (n = database_stream_read(&stream, got + len, 1000)) > 0; )
+		len += n;
+
+	GREATEST_ASSERT_EQ(len, new.codesz);
+	GREATEST_ASSERT((plain = gzip_decompress(got, len, &plainsz)));
+	GREATEST_ASSERT_EQ(plainsz, strlen(code));
+	GREATEST_ASSERT(memcmp(plain, code, plainsz) == 0);
+	free(plain);
+	database_stream_close(&stream);
+	paste_finish(&new);
+
+	GREATEST_ASSERT(database_stream_open(&database, &stream, &new, "unknown", PASTE_ENCODING_IDENTITY) < 0);
 	GREATEST_PASS();
 }
 
 GREATEST_TEST
-search_private(void)
+get_inserted_code(void)
 {
-	struct paste searched = { 0 };
+	static char code[2 * DATABASE_STREAM_CHUNK + 100];
 	struct paste original = {
-		.title = estrdup("This is secret"),
-		.author = estrdup("anonymous"),
+		.title = estrdup("chunked"),
+		.author = estrdup("unit test"),
 		.language = estrdup("nohighlight"),
-		.code = estrdup("I love you, honey"),
 		.duration = PASTE_DURATION_HOUR,
-		.visible = false
+		.visible = true
 	};
+	struct paste new = { 0 }, searched = { 0 };
 	size_t max = 1;
 
-	if (!database_insert(&original))
+	/* Not NUL terminated, only the given size must be stored. */
+	memset(code, 'x', sizeof (code));
+	memcpy(code, "needle ", 7);
+
+	if (database_insert_code(&database, &original, code, sizeof (code) - 1) < 0)
+		GREATEST_FAIL();
+	if (database_get(&database, &new, original.id) < 0)
 		GREATEST_FAIL();
 
-	/*
-	 * Search:
-	 *
-	 * title = <any>
-	 * author = <any>
-	 * language = <any>
-	 */
-	if (!database_search(&searched, &max, NULL, NULL, NULL))
+	GREATEST_ASSERT_EQ(new.codesz, sizeof (code) - 1);
+	GREATEST_ASSERT(memcmp(new.code, code, new.codesz) == 0);
+	GREATEST_ASSERT_EQ(new.code[new.codesz], '\0');
+	paste_finish(&new);
+
+	if (database_get_encoded(&database, &new, original.id, PASTE_ENCODING_GZIP) < 0)
 		GREATEST_FAIL();
 
-	GREATEST_ASSERT_EQ(max, 0);
-	GREATEST_ASSERT(!searched.id);
-	GREATEST_ASSERT(!searched.title);
-	GREATEST_ASSERT(!searched.author);
-	GREATEST_ASSERT(!searched.language);
-	GREATEST_ASSERT(!searched.code);
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_GZIP);
+	paste_finish(&new);
+
+	/* Same text uncompressed. */
+	config.compression = 0;
+	paste_init(&searched);
+
+	if (database_insert_code(&database, &searched, code, 100) < 0)
+		GREATEST_FAIL();
+	if (database_get_encoded(&database, &new, searched.id, PASTE_ENCODING_GZIP) < 0)
+		GREATEST_FAIL();
+
+	config.compression = 1024;
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_IDENTITY);
+	GREATEST_ASSERT_EQ(new.codesz, 100);
+	GREATEST_ASSERT(memcmp(new.code, code, 100) == 0);
+	paste_finish(&new);
+	paste_finish(&searched);
+
+	if (database_search(&database, &searched, &max, NULL, NULL, NULL, "needle", NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	paste_finish(&searched);
+
+	/* Refused before anything is stored. */
+	config.maxsize = 50;
+	paste_init(&new);
+
+	GREATEST_ASSERT(database_insert_code(&database, &new, code, 100) < 0);
+	GREATEST_ASSERT(!new.id);
+	config.maxsize = 0;
+	paste_finish(&new);
 	GREATEST_PASS();
 }
 
-GREATEST_SUITE(search)
+GREATEST_TEST
+get_cached(void)
 {
-	GREATEST_SET_SETUP_CB(setup, NULL);
-	GREATEST_SET_TEARDOWN_CB(finish, NULL);
-	GREATEST_RUN_TEST(search_basic);
-	GREATEST_RUN_TEST(search_notfound);
-	GREATEST_RUN_TEST(search_private);
+	struct paste original, expired, new = { 0 }, other = { 0 };
+	unsigned long long hits, misses;
+	size_t max = database.cache.max;
+
+	paste_init(&original);
+	paste_init(&expired);
+	original.code = estrdup("hot paste");
+	expired.code = estrdup("cold paste");
+	expired.duration = 0;
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+	if (database_insert(&database, &expired) < 0)
+		GREATEST_FAIL();
+
+	hits = database.cache.hits;
+	misses = database.cache.misses;
+
+	for (int i = 0; i < 3; ++i) {
+		if (database_get(&database, &new, original.id) < 0)
+			GREATEST_FAIL();
+
+		GREATEST_ASSERT_STR_EQ(new.code, "hot paste");
+		GREATEST_ASSERT_STR_EQ(new.title, original.title);
+		paste_finish(&new);
+	}
+
+	GREATEST_ASSERT_EQ(database.cache.misses, misses + 1);
+	GREATEST_ASSERT_EQ(database.cache.hits, hits + 2);
+
+	/* Already expired, neither returned nor kept. */
+	for (int i = 0; i < 2; ++i)
+		GREATEST_ASSERT(database_get(&database, &new, expired.id) < 0);
+
+	GREATEST_ASSERT_EQ(database.cache.misses, misses + 3);
+	GREATEST_ASSERT_EQ(database.cache.hits, hits + 2);
+
+	/* Hits share the code, which outlives the entry. */
+	if (database_get(&database, &new, original.id) < 0)
+		GREATEST_FAIL();
+	if (database_get(&database, &other, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(new.code == other.code);
+	cache_finish(&database.cache);
+	cache_init(&database.cache, max);
+	GREATEST_ASSERT_STR_EQ(new.code, "hot paste");
+	paste_finish(&new);
+	GREATEST_ASSERT_STR_EQ(other.code, "hot paste");
+	paste_finish(&other);
+	paste_finish(&original);
+	paste_finish(&expired);
+	GREATEST_PASS();
 }
 
 GREATEST_TEST
-clear_run(void)
+get_arena(void)
 {
-	struct paste searched = { 0 };
+	struct arena ar = { 0 };
+	struct paste original, new = { .arena = &ar };
+
+	paste_init(&original);
+	original.code = estrdup("from the arena");
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	/* First from the engine, then from the cache. */
+	for (int i = 0; i < 2; ++i) {
+		if (database_get(&database, &new, original.id) < 0)
+			GREATEST_FAIL();
+
+		GREATEST_ASSERT(new.arena == &ar);
+		GREATEST_ASSERT_STR_EQ(new.id, original.id);
+		GREATEST_ASSERT_STR_EQ(new.title, original.title);
+		GREATEST_ASSERT_STR_EQ(new.code, "from the arena");
+		paste_finish(&new);
+		new.arena = &ar;
+	}
+
+	GREATEST_ASSERT(ar.allocs >= 8);
+
+	arena_reset(&ar);
+	GREATEST_ASSERT_EQ(ar.allocs, 0);
+	GREATEST_ASSERT_EQ(ar.bytes, 0);
+
+	paste_finish(&original);
+	arena_finish(&ar);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+get_cache_budget(void)
+{
+	struct paste pastes[8], new = { 0 };
+	size_t max = database.cache.max;
+
+	/* Room for a few small pastes only. */
+	cache_finish(&database.cache);
+	cache_init(&database.cache, 3 * (sizeof (struct paste) + 256));
+
+	for (size_t i = 0; i < 8; ++i) {
+		paste_init(&pastes[i]);
+		pastes[i].code = estrdup("evicted soon");
+
+		if (database_insert(&database, &pastes[i]) < 0)
+			GREATEST_FAIL();
+		if (database_get(&database, &new, pastes[i].id) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&new);
+		GREATEST_ASSERT(database.cache.size <= database.cache.max);
+	}
+
+	GREATEST_ASSERT(database.cache.entries < 8);
+
+	/* The most recent one is still there, the first one is gone. */
+	GREATEST_ASSERT(cache_get(&database.cache, &new, pastes[7].id) == 0);
+	paste_finish(&new);
+	GREATEST_ASSERT(cache_get(&database.cache, &new, pastes[0].id) < 0);
+
+	for (size_t i = 0; i < 8; ++i)
+		paste_finish(&pastes[i]);
+
+	cache_finish(&database.cache);
+	cache_init(&database.cache, max);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+get_filtered(void)
+{
+	struct database other;
+	struct paste pastie, new = { 0 };
+	unsigned long long negatives = SQLITE(database)->shards[0].bloom.negatives;
+	char first[16];
+	size_t count;
+
+	/* Answered by the filter alone. */
+	for (int i = 0; i < 100; ++i)
+		GREATEST_ASSERT(database_get(&database, &new, bprintf("unknown%d", i)) < 0);
+
+	GREATEST_ASSERT(SQLITE(database)->shards[0].bloom.negatives >= negatives + 90);
+	GREATEST_ASSERT(bloom_size(&SQLITE(database)->shards[0].bloom) > 0);
+	GREATEST_ASSERT(bloom_rate(&SQLITE(database)->shards[0].bloom) < 0.01);
+
+	/* Created by another process, must not be filtered out. */
+	if (database_open(&other, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	paste_init(&pastie);
+	pastie.code = estrdup("int main() {}");
+
+	if (database_insert(&other, &pastie) < 0)
+		GREATEST_FAIL();
+
+	database_finish(&other);
+
+	/* Only its identifier is added, then misses are filtered again. */
+	count = SQLITE(database)->shards[0].bloom.count;
+	negatives = SQLITE(database)->shards[0].bloom.negatives;
+
+	for (int i = 0; i < 2; ++i)
+		GREATEST_ASSERT(database_get(&database, &new, "unknown") < 0);
+
+	GREATEST_ASSERT_EQ(SQLITE(database)->shards[0].bloom.count, count + 1);
+	GREATEST_ASSERT_EQ(SQLITE(database)->shards[0].bloom.negatives, negatives + 2);
+	GREATEST_ASSERT(bloom_has(&SQLITE(database)->shards[0].bloom, pastie.id));
+
+	if (database_get(&database, &new, pastie.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.code, "int main() {}");
+	paste_finish(&new);
+
+	/* Entries pruned before they were read, filled again. */
+	if (database_open(&other, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	for (int i = 0; i < 2; ++i) {
+		paste_finish(&pastie);
+		paste_init(&pastie);
+		pastie.code = estrdup("int main() {}");
+
+		if (database_insert(&other, &pastie) < 0)
+			GREATEST_FAIL();
+		if (i == 0)
+			snprintf(first, sizeof (first), "%s", pastie.id);
+	}
+
+	if (sqlite3_exec(SQLITE(other)->shards[0].handle,
+	    "DELETE FROM paste_added WHERE seq < (SELECT max(seq) FROM paste_added)",
+	    NULL, NULL, NULL) != SQLITE_OK)
+		GREATEST_FAIL();
+
+	database_finish(&other);
+	GREATEST_ASSERT(database_get(&database, &new, "unknown") < 0);
+	GREATEST_ASSERT(bloom_has(&SQLITE(database)->shards[0].bloom, first));
+	GREATEST_ASSERT(bloom_has(&SQLITE(database)->shards[0].bloom, pastie.id));
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(get)
+{
+	GREATEST_SET_SETUP_CB(setup, NULL);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(get_basic);
+	GREATEST_RUN_TEST(get_nonexistent);
+	GREATEST_RUN_TEST(get_compressed);
+	GREATEST_RUN_TEST(get_stream);
+	GREATEST_RUN_TEST(get_inserted_code);
+	GREATEST_RUN_TEST(get_cached);
+	GREATEST_RUN_TEST(get_arena);
+	GREATEST_RUN_TEST(get_cache_budget);
+	GREATEST_RUN_TEST(get_filtered);
+}
+
+GREATEST_TEST
+search_basic(void)
+{
+	struct paste searched[3] = { 0 };
 	struct paste originals[] = {
-		/* Will be deleted */
 		{
 			.title = estrdup("This is in C"),
 			.author = estrdup("markand"),
 			.language = estrdup("cpp"),
 			.code = estrdup("int main(void) {}"),
-			.duration = 1,
+			.duration = PASTE_DURATION_HOUR,
 			.visible = true
 		},
-		/* Will be deleted */
 		{
 			.title = estrdup("This is in shell"),
 			.author = estrdup("markand"),
 			.language = estrdup("shell"),
 			.code = estrdup("f() {}"),
-			.duration = 1,
+			.duration = PASTE_DURATION_HOUR,
 			.visible = true
 		},
-		/* Will be kept */
 		{
 			.title = estrdup("This is in python"),
 			.author = estrdup("NiReaS"),
@@ -437,15 +929,85 @@ clear_run(void)
 			.visible = true
 		},
 	};
-	size_t max = 1;
+	size_t max = 3;
 
 	for (int i = 0; i < 3; ++i)
-		if (!database_insert(&originals[i]))
+		if (database_insert(&database, &originals[i]) < 0)
 			GREATEST_FAIL();
 
-	/* Sleep 2 seconds to exceed the lifetime of C and shell pastes. */
-	sleep(2);
-	database_clear();
+	/*
+	 * Search:
+	 *
+	 * title = <any>
+	 * author = markand,
+	 * language = cpp
+	 */
+	if (database_search(&database, searched, &max, NULL, "markand", "cpp", NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT(searched[0].id);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "This is in C");
+	GREATEST_ASSERT_STR_EQ(searched[0].author, "markand");
+	GREATEST_ASSERT_STR_EQ(searched[0].language, "cpp");
+	GREATEST_ASSERT(!searched[0].code);
+	GREATEST_ASSERT_EQ(searched[0].duration, PASTE_DURATION_HOUR);
+	GREATEST_ASSERT(searched[0].visible);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+search_notfound(void)
+{
+	struct paste searched = { 0 };
+	struct paste original = {
+		.title = estrdup("This is in C"),
+		.author = estrdup("markand"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = true
+	};
+	size_t max = 1;
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	/*
+	 * Search:
+	 *
+	 * title = <any>
+	 * author = jean,
+	 * language = <any>
+	 */
+	if (database_search(&database, &searched, &max, NULL, "jean", NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	GREATEST_ASSERT(!searched.id);
+	GREATEST_ASSERT(!searched.title);
+	GREATEST_ASSERT(!searched.author);
+	GREATEST_ASSERT(!searched.language);
+	GREATEST_ASSERT(!searched.code);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+search_private(void)
+{
+	struct paste searched = { 0 };
+	struct paste original = {
+		.title = estrdup("This is secret"),
+		.author = estrdup("anonymous"),
+		.language = estrdup("nohighlight"),
+		.code = estrdup("I love you, honey"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = false
+	};
+	size_t max = 1;
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
 
 	/*
 	 * Search:
@@ -454,25 +1016,985 @@ clear_run(void)
 	 * author = <any>
 	 * language = <any>
 	 */
-	if (!database_search(&searched, &max, NULL, NULL, NULL))
+	if (database_search(&database, &searched, &max, NULL, NULL, NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	GREATEST_ASSERT(!searched.id);
+	GREATEST_ASSERT(!searched.title);
+	GREATEST_ASSERT(!searched.author);
+	GREATEST_ASSERT(!searched.language);
+	GREATEST_ASSERT(!searched.code);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+search_fulltext(void)
+{
+	struct paste searched[3] = { 0 };
+	struct paste originals[] = {
+		{
+			.title = estrdup("Hello in C"),
+			.author = estrdup("markand"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int main(void) { puts(\"hello\"); }"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		},
+		{
+			.title = estrdup("Hello in shell"),
+			.author = estrdup("markand"),
+			.language = estrdup("shell"),
+			.code = estrdup("echo hello"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = false
+		},
+		{
+			.title = estrdup("Nothing"),
+			.author = estrdup("NiReaS"),
+			.language = estrdup("python"),
+			.code = estrdup("f: pass"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		},
+	};
+	size_t max = 3;
+
+	for (int i = 0; i < 3; ++i)
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+
+	/* Private pastes must not be found. */
+	if (database_search(&database, searched, &max, NULL, NULL, NULL, "puts \"hello", NULL) < 0)
 		GREATEST_FAIL();
 
 	GREATEST_ASSERT_EQ(max, 1);
-	GREATEST_ASSERT(searched.id);
-	GREATEST_ASSERT_STR_EQ(searched.title, "This is in python");
-	GREATEST_ASSERT_STR_EQ(searched.author, "NiReaS");
-	GREATEST_ASSERT_STR_EQ(searched.language, "python");
-	GREATEST_ASSERT_STR_EQ(searched.code, "f: pass");
-	GREATEST_ASSERT_EQ(searched.duration, PASTE_DURATION_HOUR);
-	GREATEST_ASSERT(searched.visible);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "Hello in C");
+	GREATEST_ASSERT(searched[0].snippet);
+	GREATEST_ASSERT(strstr(searched[0].snippet, "\2puts\3"));
 	GREATEST_PASS();
 }
 
-GREATEST_SUITE(clear)
+GREATEST_TEST
+search_substring(void)
+{
+	struct paste searched[3] = { 0 };
+	struct paste originals[] = {
+		{
+			.title = estrdup("Makefile for kcgi"),
+			.author = estrdup("markand"),
+			.language = estrdup("makefile"),
+			.code = estrdup("all:"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		},
+		{
+			.title = estrdup("Another makefile"),
+			.author = estrdup("NiReaS"),
+			.language = estrdup("makefile"),
+			.code = estrdup("clean:"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		}
+	};
+	size_t max = 3;
+
+	for (int i = 0; i < 2; ++i)
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+
+	/* Indexed title and author. */
+	if (database_search(&database, searched, &max, "akefil", "rka", NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "Makefile for kcgi");
+	paste_finish(&searched[0]);
+
+	/* Too short for the index. */
+	max = 3;
+
+	if (database_search(&database, searched, &max, NULL, "Ni", NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "Another makefile");
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(search)
 {
 	GREATEST_SET_SETUP_CB(setup, NULL);
 	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(search_basic);
+	GREATEST_RUN_TEST(search_notfound);
+	GREATEST_RUN_TEST(search_private);
+	GREATEST_RUN_TEST(search_fulltext);
+	GREATEST_RUN_TEST(search_substring);
+}
+
+GREATEST_TEST
+clear_run(void)
+{
+	struct paste searched = { 0 };
+	struct paste originals[] = {
+		/* Will be deleted */
+		{
+			.title = estrdup("This is in C"),
+			.author = estrdup("markand"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int main(void) {}"),
+			.duration = 1,
+			.visible = true
+		},
+		/* Will be deleted */
+		{
+			.title = estrdup("This is in shell"),
+			.author = estrdup("markand"),
+			.language = estrdup("shell"),
+			.code = estrdup("f() {}"),
+			.duration = 1,
+			.visible = true
+		},
+		/* Will be kept */
+		{
+			.title = estrdup("This is in python"),
+			.author = estrdup("NiReaS"),
+			.language = estrdup("python"),
+			.code = estrdup("f: pass"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		},
+	};
+	size_t max = 1;
+
+	for (int i = 0; i < 3; ++i)
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+
+	/* Sleep 2 seconds to exceed the lifetime of C and shell pastes. */
+	sleep(2);
+	database_clear(&database);
+
+	/*
+	 * Search:
+	 *
+	 * title = <any>
+	 * author = <any>
+	 * language = <any>
+	 */
+	if (database_search(&database, &searched, &max, NULL, NULL, NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT(searched.id);
+	GREATEST_ASSERT_STR_EQ(searched.title, "This is in python");
+	GREATEST_ASSERT_STR_EQ(searched.author, "NiReaS");
+	GREATEST_ASSERT_STR_EQ(searched.language, "python");
+	GREATEST_ASSERT(!searched.code);
+	GREATEST_ASSERT_EQ(searched.duration, PASTE_DURATION_HOUR);
+	GREATEST_ASSERT(searched.visible);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+clear_shared(void)
+{
+	struct paste new = { 0 }, searched[2] = { 0 };
+	struct paste originals[] = {
+		/* Will be deleted */
+		{
+			.title = estrdup("original"),
+			.author = estrdup("markand"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int shared(void) {}"),
+			.duration = 1,
+			.visible = true
+		},
+		/* Will be kept, same body */
+		{
+			.title = estrdup("fork"),
+			.author = estrdup("NiReaS"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int shared(void) {}"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		},
+	};
+	size_t max = 2;
+
+	for (int i = 0; i < 2; ++i)
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+
+	sleep(2);
+	database_clear(&database);
+
+	/* The body must survive as long as one paste references it. */
+	if (database_get(&database, &new, originals[1].id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.code, "int shared(void) {}");
+
+	if (database_search(&database, searched, &max, NULL, NULL, NULL, "shared", NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "fork");
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+clear_vacuum(void)
+{
+	struct paste pastie = { 0 };
+	char code[8192];
+	int left;
+
+	/* Distinct bodies large enough to span several pages each. */
+	for (int i = 0; i < 32; ++i) {
+		for (size_t c = 0; c < sizeof (code) - 1; ++c)
+			code[c] = 'a' + (c * 7 + i * 13 + c / 11) % 26;
+
+		code[sizeof (code) - 1] = '\0';
+
+		pastie.title = estrdup(bprintf("test %d", i));
+		pastie.author = estrdup("unit test");
+		pastie.language = estrdup("cpp");
+		pastie.code = estrdup(code);
+		pastie.duration = 1;
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&pastie);
+	}
+
+	sleep(2);
+	database_clear(&database);
+
+	/* Reclaimed one page at a time, then everything. */
+	GREATEST_ASSERT((left = database_vacuum(&database, 1)) > 0);
+	GREATEST_ASSERT_EQ(database_vacuum(&database, 1), left - 1);
+	GREATEST_ASSERT_EQ(database_vacuum(&database, 1 << 20), 0);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+clear_batches(void)
+{
+	struct paste pastie = { 0 }, searched = { 0 };
+	size_t max = 1, rows = config.clearrows;
+
+	for (int i = 0; i < 10; ++i) {
+		pastie.title = estrdup(bprintf("test %d", i));
+		pastie.author = estrdup("unit test");
+		pastie.language = estrdup("cpp");
+		pastie.code = estrdup(bprintf("int main() { return %d; }", i));
+		pastie.duration = 1;
+		pastie.visible = true;
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&pastie);
+	}
+
+	sleep(2);
+
+	/* Several transactions are needed, all of them must be deleted. */
+	config.clearrows = 3;
+	database_clear(&database);
+	config.clearrows = rows;
+
+	if (database_search(&database, &searched, &max, NULL, NULL, NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+clear_vacuum_upgrade(void)
+{
+	struct paste pastie = {
+		.title = estrdup("upgraded"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = true
+	};
+	struct paste searched[1];
+	size_t max = NELEM(searched);
+	sqlite3_stmt *stmt;
+
+	if (database_insert(&database, &pastie) < 0)
+		GREATEST_FAIL();
+
+	/* Back to a file from before incremental vacuum. */
+	if (sqlite3_exec(SQLITE(database)->shards[0].handle,
+	    "PRAGMA auto_vacuum = NONE; VACUUM; PRAGMA user_version = 9", NULL, NULL, NULL) != SQLITE_OK)
+		GREATEST_FAIL();
+
+	database_finish(&database);
+
+	if (database_open(&database, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+	if (database_search(&database, searched, &max, NULL, NULL, NULL, "main", NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT_STR_EQ(searched[0].title, "upgraded");
+	paste_finish(&searched[0]);
+	paste_finish(&pastie);
+
+	if (sqlite3_prepare_v2(SQLITE(database)->shards[0].handle, "PRAGMA auto_vacuum", -1, &stmt, NULL) != SQLITE_OK)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+	GREATEST_ASSERT_EQ(sqlite3_column_int(stmt, 0), 2);
+	sqlite3_finalize(stmt);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+clear_maintenance(void)
+{
+	struct database other = { 0 };
+	struct paste new = { 0 };
+	struct paste original = {
+		.title = estrdup("expired"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = 1,
+		.visible = true
+	};
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	/* Nothing needed to serve pastes, even with group commit. */
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "safe");
+	config.commitrows = 2;
+
+	if (database_open_maintenance(&other, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	config.commitrows = 0;
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "default");
+
+	GREATEST_ASSERT(!other.grouped);
+	GREATEST_ASSERT_EQ(other.cache.max, 0);
+	GREATEST_ASSERT(!SQLITE(other)->shards[0].bloom.bits);
+	GREATEST_ASSERT(SQLITE(other)->shards[0].wal < 0);
+
+	sleep(2);
+	database_clear(&other);
+	database_finish(&other);
+	GREATEST_ASSERT(database_get(&database, &new, original.id) < 0);
+	paste_finish(&original);
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(clear)
+{
+	GREATEST_SET_SETUP_CB(setup, NULL);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(clear_run);
+	GREATEST_RUN_TEST(clear_shared);
+	GREATEST_RUN_TEST(clear_batches);
+	GREATEST_RUN_TEST(clear_vacuum);
+	GREATEST_RUN_TEST(clear_vacuum_upgrade);
+	GREATEST_RUN_TEST(clear_maintenance);
+}
+
+GREATEST_TEST
+statements_reuse(void)
+{
+	struct paste pastes[10];
+	size_t max;
+	unsigned long long hits = SQLITE(database)->hits;
+
+	for (int i = 0; i < 3; ++i) {
+		max = 10;
+
+		if (database_recents(&database, pastes, &max, NULL) < 0)
+			GREATEST_FAIL();
+	}
+
+	GREATEST_ASSERT_EQ(SQLITE(database)->hits, hits + 3);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+statements_group_commit(void)
+{
+	struct paste pastie = { 0 }, new = { 0 };
+
+	/* Commits are not synced one by one with the default profile anyway. */
+	database_finish(&database);
+	config.commitrows = 2;
+
+	if (database_open(&database, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(!database.grouped);
+	GREATEST_ASSERT(SQLITE(database)->shards[0].wal < 0);
+
+	/* Reopen with group commit every two pastes. */
+	database_finish(&database);
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "safe");
+
+	if (database_open(&database, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(database.grouped);
+	GREATEST_ASSERT(SQLITE(database)->shards[0].wal >= 0);
+
+	/* Alone, each paste waits for the window then is synced. */
+	for (int i = 0; i < 3; ++i) {
+		paste_finish(&pastie);
+		pastie.title = estrdup(bprintf("test %d", i));
+		pastie.author = estrdup("unit test");
+		pastie.language = estrdup("cpp");
+		pastie.code = estrdup("int main() {}");
+		pastie.duration = PASTE_DURATION_HOUR;
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		GREATEST_ASSERT_EQ(database.committed, (unsigned long long)i + 1);
+		GREATEST_ASSERT_EQ(database.synced, database.committed);
+	}
+
+	config.commitrows = 0;
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "default");
+
+	if (database_get(&database, &new, pastie.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "test 2");
+	paste_finish(&new);
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+statements_reader(void)
+{
+	struct database_shard *sh = &SQLITE(database)->shards[0];
+	struct paste pastie, new = { 0 }, pastes[2];
+	size_t max = NELEM(pastes);
+
+	paste_init(&pastie);
+	pastie.visible = true;
+	pastie.code = estrdup("int main() {}");
+
+	if (database_insert(&database, &pastie) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(sqlite3_db_readonly(sh->reader, "main") == 1);
+	GREATEST_ASSERT(sqlite3_exec(sh->reader, "DELETE FROM paste", NULL, NULL, NULL) != SQLITE_OK);
+
+	/* Pages are served from the last commit while the writer is busy. */
+	if (sqlite3_exec(sh->handle, "BEGIN IMMEDIATE; DELETE FROM paste", NULL, NULL, NULL) != SQLITE_OK)
+		GREATEST_FAIL();
+	if (database_get(&database, &new, pastie.id) < 0)
+		GREATEST_FAIL();
+	if (database_recents(&database, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	sqlite3_exec(sh->handle, "ROLLBACK", NULL, NULL, NULL);
+
+	GREATEST_ASSERT_STR_EQ(new.code, "int main() {}");
+	GREATEST_ASSERT_EQ(max, 1U);
+	paste_finish(&new);
+	paste_finish(&pastes[0]);
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(statements)
+{
+	GREATEST_SET_SETUP_CB(setup, NULL);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(statements_reuse);
+	GREATEST_RUN_TEST(statements_group_commit);
+	GREATEST_RUN_TEST(statements_reader);
+}
+
+GREATEST_TEST
+shards_spread(void)
+{
+	struct paste originals[24] = { 0 }, pastes[24], new = { 0 }, key = { 0 };
+	size_t max, seen = 0;
+
+	for (int i = 0; i < 24; ++i) {
+		originals[i].title = estrdup(bprintf("test %d", i));
+		originals[i].author = estrdup("unit test");
+		originals[i].language = estrdup("cpp");
+		originals[i].code = estrdup(bprintf("int main() { return %d; }", i));
+		originals[i].duration = PASTE_DURATION_HOUR;
+		originals[i].visible = true;
+
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+	}
+
+	/* Every paste is found in the shard its identifier maps to. */
+	for (int i = 0; i < 24; ++i) {
+		if (database_get(&database, &new, originals[i].id) < 0)
+			GREATEST_FAIL();
+
+		GREATEST_ASSERT_STR_EQ(new.code, originals[i].code);
+		paste_finish(&new);
+	}
+
+	/* Merged listings are ordered by (date, id) across the shards. */
+	do {
+		max = 5;
+
+		if (database_recents(&database, pastes, &max, seen ? &key : NULL) < 0)
+			GREATEST_FAIL();
+
+		for (size_t i = 0; i < max; ++i) {
+			if (seen)
+				GREATEST_ASSERT(pastes[i].timestamp < key.timestamp ||
+				    (pastes[i].timestamp == key.timestamp &&
+				     strcmp(pastes[i].id, key.id) < 0));
+
+			free(key.id);
+			key.id = estrdup(pastes[i].id);
+			key.timestamp = pastes[i].timestamp;
+			seen++;
+			paste_finish(&pastes[i]);
+		}
+	} while (max == 5);
+
+	free(key.id);
+	GREATEST_ASSERT_EQ(seen, 24U);
+
+	max = NELEM(pastes);
+
+	if (database_search(&database, pastes, &max, NULL, NULL, NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 24U);
+
+	for (size_t i = 0; i < max; ++i)
+		paste_finish(&pastes[i]);
+
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(shards)
+{
+	static const size_t shards = TEST_SHARDS;
+
+	GREATEST_SET_SETUP_CB(setup, (void *)&shards);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(shards_spread);
+}
+
+GREATEST_TEST
+buckets_drop(void)
+{
+	struct paste originals[] = {
+		{
+			.title = estrdup("short"),
+			.author = estrdup("unit test"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int main(void) {}"),
+			.duration = 1,
+			.visible = true
+		},
+		{
+			.title = estrdup("long"),
+			.author = estrdup("unit test"),
+			.language = estrdup("cpp"),
+			.code = estrdup("int main(void) {}"),
+			.duration = PASTE_DURATION_HOUR,
+			.visible = true
+		}
+	};
+	struct paste new = { 0 }, pastes[2];
+	size_t max = NELEM(pastes);
+	long long int expires;
+
+	for (size_t i = 0; i < NELEM(originals); ++i)
+		if (database_insert(&database, &originals[i]) < 0)
+			GREATEST_FAIL();
+
+	/* Nothing in the shard but the identifiers. */
+	GREATEST_ASSERT_EQ(SQLITE(database)->bucketsz, 2);
+	GREATEST_ASSERT(database_get(&database, &new, originals[0].id) == 0);
+	paste_finish(&new);
+
+	expires = SQLITE(database)->buckets[0].expires;
+
+	if (SQLITE(database)->buckets[1].expires < expires)
+		expires = SQLITE(database)->buckets[1].expires;
+
+	GREATEST_ASSERT(access(bprintf("%s.bucket-%lld", TEST_DATABASE, expires), F_OK) == 0);
+
+	/* Not found once expired, then the whole file goes. */
+	sleep(2);
+	GREATEST_ASSERT(database_get(&database, &new, originals[0].id) < 0);
+	database_clear(&database);
+	GREATEST_ASSERT(access(bprintf("%s.bucket-%lld", TEST_DATABASE, expires), F_OK) < 0);
+	GREATEST_ASSERT_EQ(SQLITE(database)->bucketsz, 1);
+
+	if (database_get(&database, &new, originals[1].id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "long");
+	paste_finish(&new);
+
+	if (database_recents(&database, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	GREATEST_ASSERT_STR_EQ(pastes[0].id, originals[1].id);
+	paste_finish(&pastes[0]);
+
+	for (size_t i = 0; i < NELEM(originals); ++i)
+		paste_finish(&originals[i]);
+
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+buckets_shared(void)
+{
+	struct database other = { 0 };
+	struct paste original = {
+		.title = estrdup("from another process"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = 1,
+		.visible = true
+	};
+	struct paste new = { 0 }, pastes[2];
+	size_t max = NELEM(pastes);
+
+	/* Buckets created by the other are found without reopening. */
+	if (database_open(&other, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+	if (database_recents(&other, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+	if (database_get(&other, &new, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "from another process");
+	paste_finish(&new);
+	max = NELEM(pastes);
+
+	if (database_recents(&other, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 1);
+	paste_finish(&pastes[0]);
+
+	/* Removed by one while the other still has it open. */
+	sleep(2);
+	database_clear(&other);
+	GREATEST_ASSERT(database_get(&database, &new, original.id) < 0);
+	max = NELEM(pastes);
+
+	if (database_recents(&database, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	GREATEST_ASSERT_EQ(SQLITE(database)->bucketsz, 0);
+	paste_finish(&original);
+	database_finish(&other);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+buckets_expired(void)
+{
+	struct paste original = {
+		.title = estrdup("expired"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = 1,
+		.visible = true
+	};
+	struct paste new = { 0 }, pastes[1];
+	size_t max = NELEM(pastes);
+
+	/* Its bucket lasts much longer than the paste itself. */
+	config.databasebucket = PASTE_DURATION_HOUR;
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	sleep(2);
+	GREATEST_ASSERT(database_get(&database, &new, original.id) < 0);
+
+	if (database_recents(&database, pastes, &max, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	max = NELEM(pastes);
+
+	if (database_search(&database, pastes, &max, "expired", NULL, NULL, NULL, NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	max = NELEM(pastes);
+
+	if (database_search(&database, pastes, &max, NULL, NULL, NULL, "main", NULL) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0);
+	GREATEST_ASSERT_EQ(SQLITE(database)->bucketsz, 1);
+	paste_finish(&original);
+	GREATEST_PASS();
+}
+
+static int syncing;
+
+static void *
+sync_loop(void *data)
+{
+	while (__atomic_load_n(&syncing, __ATOMIC_ACQUIRE))
+		database_sync(data);
+
+	return NULL;
+}
+
+GREATEST_TEST
+buckets_sync(void)
+{
+	struct paste pastie = { 0 };
+	pthread_t thread;
+	int failed = 0;
+
+	/* Buckets come and go while another thread syncs their WAL. */
+	database_finish(&database);
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "safe");
+	config.commitrows = 1;
+
+	if (database_open(&database, TEST_DATABASE) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT(database.grouped);
+	__atomic_store_n(&syncing, 1, __ATOMIC_RELEASE);
+
+	if (pthread_create(&thread, NULL, sync_loop, &database) != 0)
+		GREATEST_FAIL();
+
+	for (int round = 0; round < 2; ++round) {
+		/* One bucket per paste. */
+		for (int i = 0; i < 16; ++i) {
+			paste_finish(&pastie);
+			pastie.title = estrdup(bprintf("test %d", i));
+			pastie.author = estrdup("unit test");
+			pastie.language = estrdup("cpp");
+			pastie.code = estrdup("int main() {}");
+			pastie.duration = 1 + i;
+			failed |= database_insert(&database, &pastie) < 0;
+		}
+
+		sleep(2);
+		database_clear(&database);
+	}
+
+	__atomic_store_n(&syncing, 0, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+	config.commitrows = 0;
+	snprintf(config.databaseprofile, sizeof (config.databaseprofile), "default");
+
+	GREATEST_ASSERT(!failed);
+	GREATEST_ASSERT(SQLITE(database)->bucketsz > 0);
+	GREATEST_ASSERT(SQLITE(database)->bucketsz < 32);
+	GREATEST_ASSERT_EQ(database.synced, database.committed);
+	paste_finish(&pastie);
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(buckets)
+{
+	GREATEST_SET_SETUP_CB(setup_buckets, NULL);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(recents_one);
+	GREATEST_RUN_TEST(recents_hidden);
+	GREATEST_RUN_TEST(recents_many);
+	GREATEST_RUN_TEST(recents_after);
+	GREATEST_RUN_TEST(get_basic);
+	GREATEST_RUN_TEST(get_nonexistent);
+	GREATEST_RUN_TEST(get_stream);
+	GREATEST_RUN_TEST(search_basic);
+	GREATEST_RUN_TEST(search_fulltext);
+	GREATEST_RUN_TEST(search_substring);
+	GREATEST_RUN_TEST(clear_run);
+	GREATEST_RUN_TEST(clear_shared);
+	GREATEST_RUN_TEST(clear_batches);
+	GREATEST_RUN_TEST(buckets_drop);
+	GREATEST_RUN_TEST(buckets_shared);
+	GREATEST_RUN_TEST(buckets_expired);
+	GREATEST_RUN_TEST(buckets_sync);
+}
+
+GREATEST_TEST
+log_reopen(void)
+{
+	struct paste original = {
+		.title = estrdup("kept"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = true
+	};
+	struct paste new = { 0 };
+
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+
+	/* The index is built again from the file. */
+	database_finish(&database);
+
+	if (database_open(&database, TEST_LOG) < 0)
+		GREATEST_FAIL();
+	if (database_get(&database, &new, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "kept");
+	GREATEST_ASSERT_STR_EQ(new.code, "int main(void) {}");
+	GREATEST_ASSERT_EQ(new.encoding, PASTE_ENCODING_IDENTITY);
+	paste_finish(&new);
+	paste_finish(&original);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+log_shared(void)
+{
+	struct database other = { 0 };
+	struct paste original = {
+		.title = estrdup("from another process"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = 1,
+		.visible = true
+	};
+	struct paste new = { 0 }, pastes[2];
+	size_t max = NELEM(pastes);
+
+	/* Seen by the other without reopening. */
+	if (database_open(&other, TEST_LOG) < 0)
+		GREATEST_FAIL();
+	if (database_insert(&database, &original) < 0)
+		GREATEST_FAIL();
+	if (database_get(&other, &new, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "from another process");
+	paste_finish(&new);
+
+	/* Expired pastes are gone before and after the file is rewritten. */
+	sleep(2);
+
+	GREATEST_ASSERT(database_get(&other, &new, original.id) < 0);
+	database_clear(&database);
+	GREATEST_ASSERT(database_recents(&other, pastes, &max, NULL) == 0);
+	GREATEST_ASSERT_EQ(max, 0);
+
+	paste_finish(&original);
+	original = (struct paste) {
+		.title = estrdup("after rewrite"),
+		.author = estrdup("unit test"),
+		.language = estrdup("cpp"),
+		.code = estrdup("int main(void) {}"),
+		.duration = PASTE_DURATION_HOUR,
+		.visible = true
+	};
+
+	if (database_insert(&other, &original) < 0)
+		GREATEST_FAIL();
+	if (database_get(&database, &new, original.id) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_STR_EQ(new.title, "after rewrite");
+	paste_finish(&new);
+	paste_finish(&original);
+	database_finish(&other);
+	GREATEST_PASS();
+}
+
+GREATEST_TEST
+log_seek(void)
+{
+	struct paste pastes[4], pastie = { 0 }, after = { .id = "" };
+	size_t max = NELEM(pastes);
+
+	for (int i = 0; i < 3; ++i) {
+		paste_init(&pastie);
+		pastie.visible = true;
+		pastie.code = estrdup("int main() {}");
+
+		if (database_insert(&database, &pastie) < 0)
+			GREATEST_FAIL();
+
+		paste_finish(&pastie);
+	}
+
+	/* Nothing is older than an hour ago, everything is older than the future. */
+	after.timestamp = time(NULL) - PASTE_DURATION_HOUR;
+
+	if (database_recents(&database, pastes, &max, &after) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 0U);
+	after.timestamp = time(NULL) + 1;
+	max = NELEM(pastes);
+
+	if (database_recents(&database, pastes, &max, &after) < 0)
+		GREATEST_FAIL();
+
+	GREATEST_ASSERT_EQ(max, 3U);
+
+	for (size_t i = 0; i < max; ++i)
+		paste_finish(&pastes[i]);
+
+	GREATEST_PASS();
+}
+
+GREATEST_SUITE(log_engine)
+{
+	GREATEST_SET_SETUP_CB(setup_log, NULL);
+	GREATEST_SET_TEARDOWN_CB(finish, NULL);
+	GREATEST_RUN_TEST(recents_empty);
+	GREATEST_RUN_TEST(recents_one);
+	GREATEST_RUN_TEST(recents_hidden);
+	GREATEST_RUN_TEST(recents_many);
+	GREATEST_RUN_TEST(recents_limits);
+	GREATEST_RUN_TEST(recents_after);
+	GREATEST_RUN_TEST(recents_cursor);
+	GREATEST_RUN_TEST(get_basic);
+	GREATEST_RUN_TEST(get_nonexistent);
+	GREATEST_RUN_TEST(get_arena);
+	GREATEST_RUN_TEST(search_basic);
+	GREATEST_RUN_TEST(search_notfound);
+	GREATEST_RUN_TEST(search_private);
+	GREATEST_RUN_TEST(search_substring);
 	GREATEST_RUN_TEST(clear_run);
+	GREATEST_RUN_TEST(log_reopen);
+	GREATEST_RUN_TEST(log_shared);
+	GREATEST_RUN_TEST(log_seek);
 }
 
 GREATEST_MAIN_DEFS();
@@ -485,5 +2007,9 @@ main(int argc, char **argv)
 	GREATEST_RUN_SUITE(get);
 	GREATEST_RUN_SUITE(search);
 	GREATEST_RUN_SUITE(clear);
+	GREATEST_RUN_SUITE(statements);
+	GREATEST_RUN_SUITE(shards);
+	GREATEST_RUN_SUITE(buckets);
+	GREATEST_RUN_SUITE(log_engine);
 	GREATEST_MAIN_END();
 }
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "arena.h"
 #include "config.h"
 #include "paste.h"
 #include "util.h"
@@ -295,7 +296,7 @@ path(const char *filename)
 }
 
 void
-replace(char **dst, const char *s)
+replace(struct arena *owner, char **dst, const char *s)
 {
 	assert(dst);
 	assert(s);
@@ -304,7 +305,12 @@ replace(char **dst, const char *s)
 	while (*s && isspace(*s))
 		s++;
 
-	if (*s) {
+	if (!*s)
+		return;
+
+	if (owner)
+		*dst = arena_strdup(owner, s);
+	else {
 		free(*dst);
 		*dst = estrdup(s);
 	}
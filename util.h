@@ -24,6 +24,7 @@
 
 #define NELEM(x) (sizeof (x) / sizeof (x)[0])
 
+struct arena;
 struct tm;
 struct kreq;
 
@@ -56,8 +57,13 @@ bstrftime(const char *, const struct tm *);
 const char *
 path(const char *);
 
+/**
+ * Replace *dst with s without its leading spaces unless there is nothing
+ * left, the copy comes from the arena if it is not NULL and the previous
+ * string is freed otherwise.
+ */
 void
-replace(char **, const char *);
+replace(struct arena *, char **, const char *);
 
 const char *
 ttl(time_t, long long int);